@@ -0,0 +1,71 @@
+/**
+ * @file alpha_bench.cpp
+ *
+ * 半透明のウィンドウの描画にかかる時間を、不透明なウィンドウのコピーと比べる
+ */
+#include <memory>
+
+#include "bench.hpp"
+#include "frame_buffer.hpp"
+#include "window.hpp"
+
+namespace {
+	const int kScreenWidth = 1920, kScreenHeight = 1080;
+	const int kWindowWidth = 640, kWindowHeight = 480;
+	const int kIterations = 2000;
+
+	/**
+	 * @brief グラデーションを描いたウィンドウを作る。alphaが0でなければピクセルごとのアルファ値を持たせる
+	 */
+	std::shared_ptr<Window> MakeWindow(bool alpha) {
+		auto window = std::make_shared<Window>(kWindowWidth, kWindowHeight, kPixelBGRResv8BitPerColor);
+		window->SetAlphaBlending(alpha);
+		for (int y = 0; y < kWindowHeight; ++y) {
+			for (int x = 0; x < kWindowWidth; ++x) {
+				const uint8_t a = alpha ? static_cast<uint8_t>(x * 255 / (kWindowWidth - 1)) : 255;
+				window->Write({x, y}, {static_cast<uint8_t>(x), static_cast<uint8_t>(y), 0x80, a});
+			}
+		}
+		return window;
+	}
+}
+
+int main() {
+	FrameBufferConfig config{};
+	config.horizontal_resolution = kScreenWidth;
+	config.vertical_resolution = kScreenHeight;
+	config.pixel_format = kPixelBGRResv8BitPerColor;
+	FrameBuffer back_buffer;
+	back_buffer.Initialize(config);
+
+	auto opaque = MakeWindow(false);
+	auto keyed = MakeWindow(false);
+	// 左半分を透過色で塗り、透過色の区間がある典型的なウィンドウにする
+	keyed->FillRect({0, 0}, {kWindowWidth / 2, kWindowHeight}, {1, 2, 3});
+	keyed->SetTransparentColor(PixelColor{1, 2, 3});
+	auto alpha = MakeWindow(true);
+
+	const Vector2D<int> pos{100, 100};
+	const Rectangle<int> area{{0, 0}, {kScreenWidth, kScreenHeight}};
+	const double pixels = static_cast<double>(kWindowWidth) * kWindowHeight;
+	auto draw = [&](const std::shared_ptr<Window>& window, uint8_t opacity) {
+		return bench::Measure(kIterations, [&] {
+			window->DrawTo(back_buffer, pos, area, opacity);
+			bench::DoNotOptimize(*back_buffer.PixelAddr(pos));
+		});
+	};
+
+	printf("Window::DrawTo %dx%d into a %dx%d back buffer\n",
+		   kWindowWidth, kWindowHeight, kScreenWidth, kScreenHeight);
+	const double base = draw(opaque, 255);
+	auto report = [&](const char* name, double seconds) {
+		printf("  %-36s %9.3f ms  %8.2f Mpixels/s  %5.2fx opaque copy\n",
+			   name, seconds * 1e3, pixels / seconds / 1e6, seconds / base);
+	};
+	report("opaque copy", base);
+	report("transparent color", draw(keyed, 255));
+	report("per-pixel alpha", draw(alpha, 255));
+	report("opaque window, layer opacity 192", draw(opaque, 192));
+	report("per-pixel alpha, layer opacity 192", draw(alpha, 192));
+	return 0;
+}
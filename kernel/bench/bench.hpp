@@ -0,0 +1,56 @@
+/**
+ * @file bench.hpp
+ *
+ * ホスト上で動かすベンチマークの共通処理
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+namespace bench {
+	/**
+	 * @brief 最適化で計算が消されないよう、valueを使ったことにする
+	 */
+	template <typename T>
+	inline void DoNotOptimize(const T& value) {
+		__asm__ volatile("" : : "r"(&value) : "memory");
+	}
+
+	/**
+	 * @brief fnをiterations回呼び、1回あたりの秒数を返す
+	 *
+	 * 計測の前に1回呼んで、キャッシュやページの割り当てを済ませておく
+	 */
+	template <typename F>
+	double Measure(int iterations, F&& fn) {
+		fn();
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; ++i) {
+			fn();
+		}
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		return elapsed.count() / iterations;
+	}
+
+	/**
+	 * @brief 1回あたりの時間と、1回でbytesバイト処理したときの転送速度を表示する
+	 */
+	inline void ReportBandwidth(const char* name, double seconds, double bytes) {
+		printf("  %-36s %9.3f ms  %8.2f GB/s\n", name, seconds * 1e3, bytes / seconds / 1e9);
+	}
+
+	/**
+	 * @brief 1回あたりの時間をマイクロ秒単位で表示する
+	 */
+	inline void ReportLatency(const char* name, double seconds) {
+		printf("  %-36s %9.3f us\n", name, seconds * 1e6);
+	}
+
+	/**
+	 * @brief 1回あたりの時間と、1回でcount個処理したときの1秒あたりの処理数(百万単位)を表示する
+	 */
+	inline void ReportRate(const char* name, double seconds, double count, const char* unit) {
+		printf("  %-36s %9.3f ms  %8.2f M%s/s\n", name, seconds * 1e3, count / seconds / 1e6, unit);
+	}
+}
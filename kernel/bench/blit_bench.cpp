@@ -0,0 +1,71 @@
+/**
+ * @file blit_bench.cpp
+ *
+ * 全画面のコピーを、行ごとのmemcpy(以前のFrameBuffer::Copy)とblit.cppの関数で比べる
+ */
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "bench.hpp"
+#include "blit.hpp"
+#include "frame_buffer.hpp"
+
+namespace {
+	FrameBufferConfig MakeConfig(int width, int height, uint8_t* buffer) {
+		FrameBufferConfig config{};
+		config.frame_buffer = buffer;
+		config.pixels_per_scan_line = width;
+		config.horizontal_resolution = width;
+		config.vertical_resolution = height;
+		config.pixel_format = kPixelBGRResv8BitPerColor;
+		return config;
+	}
+
+	void RunCopy(int width, int height) {
+		printf("full-screen copy %dx%d\n", width, height);
+		const size_t num_pixels = static_cast<size_t>(width) * height;
+		const double bytes = 4.0 * num_pixels;
+		// 1回の計測で合計4GBほどコピーするように回数を決める
+		const int iterations = std::max(20, static_cast<int>(4e9 / bytes));
+
+		std::vector<uint32_t> src(num_pixels), dst(num_pixels);
+		for (size_t i = 0; i < num_pixels; ++i) {
+			src[i] = i * 2654435761u;
+		}
+
+		auto per_line = [&](auto copy_line, bool fence) {
+			return bench::Measure(iterations, [&] {
+				for (int y = 0; y < height; ++y) {
+					copy_line(&dst[y * width], &src[y * width], width);
+				}
+				if (fence) {
+					StoreFence();
+				}
+				bench::DoNotOptimize(dst[0]);
+			});
+		};
+
+		// ホストのmemcpyはglibcの実装なので、カーネルが使うnewlibのmemcpyより速いことに注意
+		bench::ReportBandwidth("memcpy per line (baseline)", per_line(
+			[](uint32_t* d, const uint32_t* s, size_t n) { memcpy(d, s, 4 * n); }, false), bytes);
+		bench::ReportBandwidth("CopyPixels32", per_line(CopyPixels32, false), bytes);
+		bench::ReportBandwidth("StreamPixels32 + StoreFence", per_line(StreamPixels32, true), bytes);
+
+		// dstを画面とみなすFrameBufferを作り、LayerManagerが使うFrameBuffer::Copyそのものを測る
+		FrameBuffer back, screen;
+		back.Initialize(MakeConfig(width, height, nullptr));
+		screen.Initialize(MakeConfig(width, height, reinterpret_cast<uint8_t*>(dst.data())));
+		const Rectangle<int> area{{0, 0}, {width, height}};
+		bench::ReportBandwidth("FrameBuffer::Copy to VRAM", bench::Measure(iterations, [&] {
+			screen.Copy({0, 0}, back, area);
+			bench::DoNotOptimize(dst[0]);
+		}), bytes);
+	}
+}
+
+int main() {
+	RunCopy(1920, 1080);
+	RunCopy(3840, 2160);
+	return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file console_bench.cpp
+ *
+ * kDebugのログをコンソールに流したときに、1秒あたり何行を表示できるかを測る
+ *
+ * Log()で記録し、メインループと同じくDrainLog()とConsole::Render()で書式化と描画を行う
+ * 1周あたりのログの行数を変えて、描画を1周にまとめる効果を見る
+ *
+ * 最後に1920x1080の画面いっぱいまでResizeしたコンソールで、全行の描き直しと画面への反映にかかる時間を
+ * 60Hzの1フレーム(16.7ms)と比べる
+ */
+#include <cstring>
+#include <memory>
+
+#include "bench.hpp"
+#include "console.hpp"
+#include "frame_buffer.hpp"
+#include "layer.hpp"
+#include "logger.hpp"
+
+namespace {
+	const int kTotalLines = 20000;
+	// 8x16ドットの文字で1920x1080の画面を埋める行数と桁数
+	const int kLargeRows = 67, kLargeColumns = 240;
+	const int kRefreshIterations = 200;
+	const double kFrameSeconds = 1.0 / 60;
+}
+
+int main() {
+	auto window = std::make_shared<Window>(8 * Console::kDefaultColumns, 16 * Console::kDefaultRows,
+										   kPixelBGRResv8BitPerColor);
+	console = new Console{kDesktopFGColor, kDesktopBGColor};
+	console->SetWindow(window);
+	SetLogLevel(kDebug);
+
+	printf("Log(kDebug) to a %dx%d console window, %d lines per run\n",
+		   Console::kDefaultColumns, Console::kDefaultRows, kTotalLines);
+	for (int lines_per_loop : {1, 10, 100}) {
+		const double seconds = bench::Measure(3, [&] {
+			for (int line = 0; line < kTotalLines; line += lines_per_loop) {
+				for (int i = 0; i < lines_per_loop; ++i) {
+					Log(kDebug, "xhci: port %d status %08x, slot=%d ep=%d len=%lu\n",
+						line % 16, 0x201203 + i, i % 8, 1, static_cast<unsigned long>(line + i));
+				}
+				DrainLog();
+				console->Render();
+			}
+			bench::DoNotOptimize(*window);
+		});
+		char name[64];
+		snprintf(name, sizeof(name), "%d line(s) per main loop", lines_per_loop);
+		bench::ReportRate(name, seconds, kTotalLines, "lines");
+	}
+
+	screen_config.horizontal_resolution = 1920;
+	screen_config.vertical_resolution = 1080;
+	screen_config.pixel_format = kPixelBGRResv8BitPerColor;
+	FrameBuffer screen;
+	screen.Initialize(screen_config);
+	LayerManager manager;
+	manager.SetWriter(&screen);
+	layer_manager = &manager;
+
+	const auto layer_id = manager.NewLayer().SetWindow(window).ID();
+	manager.UpDown(layer_id, 0);
+	console->SetLayerID(layer_id);
+	console->Resize(kLargeRows, kLargeColumns);
+
+	// 画面と1画面分の履歴を、行末まで文字の詰まった行で埋める
+	const char* sample = "[kDebug] xhci: port 3 status 0x00201203, slot=2 ep=1 len=8; ";
+	const size_t sample_len = strlen(sample);
+	char line[kLargeColumns + 1];
+	for (int row = 0; row < 2 * kLargeRows; ++row) {
+		for (int col = 0; col < kLargeColumns - 1; ++col) {
+			line[col] = sample[(row * 7 + col) % sample_len];
+		}
+		line[kLargeColumns - 1] = '\n';
+		line[kLargeColumns] = '\0';
+		console->PutString(line);
+	}
+	console->Flush();
+
+	printf("Full refresh of a %dx%d console layer on a 1920x1080 screen\n", kLargeColumns, kLargeRows);
+	// 1画面分ずらすと全行が描き直しになる。過去と現在を交互に表示する
+	int direction = 1;
+	auto report_frame = [](const char* name, double seconds) {
+		printf("  %-36s %9.3f ms  %5.1f%% of a 16.7 ms frame\n", name, seconds * 1e3, seconds / kFrameSeconds * 100);
+	};
+	report_frame("ScrollView(Rows()) + Render", bench::Measure(kRefreshIterations, [&] {
+		console->ScrollView(direction * console->Rows());
+		direction = -direction;
+		console->Render();
+		bench::DoNotOptimize(*console);
+	}));
+	manager.Flush();
+	report_frame("ScrollView(Rows()) + Flush", bench::Measure(kRefreshIterations, [&] {
+		console->ScrollView(direction * console->Rows());
+		direction = -direction;
+		console->Flush();
+	}));
+	const auto& stats = manager.LastPresentStats();
+	printf("    last frame presented %zu rects, %.1f KiB\n", stats.rects, stats.bytes / 1024.0);
+	return 0;
+}
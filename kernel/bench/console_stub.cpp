@@ -0,0 +1,15 @@
+/**
+ * @file console_stub.cpp
+ *
+ * console.cppをリンクしないベンチマーク用に、layer.cppのInitializeLayerが参照するものだけを用意する
+ */
+#include "console.hpp"
+
+Console* console;
+
+void Console::SetWindow(const std::shared_ptr<Window>& window) {}
+void Console::SetLayerID(unsigned int layer_id) {}
+unsigned int Console::LayerID() const { return 0; }
+void Console::Resize(int rows, int columns) {}
+int Console::Rows() const { return 0; }
+int Console::Columns() const { return 0; }
@@ -0,0 +1,161 @@
+/**
+ * @file layer_bench.cpp
+ *
+ * 数百個のレイヤがあるときのLayerManagerの操作にかかる時間を、レイヤ数を変えて測る
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "bench.hpp"
+#include "frame_buffer.hpp"
+#include "layer.hpp"
+
+namespace {
+	const int kScreenWidth = 1920, kScreenHeight = 1080;
+	const int kWindowWidth = 96, kWindowHeight = 64;
+	const int kIterations = 2000;
+
+	Vector2D<int> RandomPosition() {
+		return {rand() % (kScreenWidth - kWindowWidth), rand() % (kScreenHeight - kWindowHeight)};
+	}
+
+	void Run(int num_layers, bool tiled) {
+		printf("%d layers, %s composition\n", num_layers, tiled ? "tiled" : "whole-stack");
+		srand(1);
+
+		FrameBufferConfig config{};
+		config.horizontal_resolution = kScreenWidth;
+		config.vertical_resolution = kScreenHeight;
+		config.pixel_format = kPixelBGRResv8BitPerColor;
+		FrameBuffer screen;
+		screen.Initialize(config);
+
+		LayerManager manager;
+		manager.SetWriter(&screen);
+		manager.SetTiledComposition(tiled);
+
+		auto bgwindow = std::make_shared<Window>(kScreenWidth, kScreenHeight, config.pixel_format);
+		bgwindow->FillRect({0, 0}, {kScreenWidth, kScreenHeight}, {0x20, 0x40, 0x60});
+		manager.UpDown(manager.NewLayer().SetWindow(bgwindow).ID(), 0);
+
+		std::vector<unsigned int> ids;
+		Layer* last_layer = nullptr;
+		for (int i = 0; i < num_layers; ++i) {
+			auto window = std::make_shared<Window>(kWindowWidth, kWindowHeight, config.pixel_format);
+			window->FillRect({0, 0}, {kWindowWidth, kWindowHeight},
+							 {static_cast<uint8_t>(i), 0x80, 0x80});
+			last_layer = &manager.NewLayer().SetWindow(window).Move(RandomPosition());
+			manager.UpDown(last_layer->ID(), i + 1);
+			ids.push_back(last_layer->ID());
+		}
+		manager.Draw({{0, 0}, {kScreenWidth, kScreenHeight}});
+		manager.Present();
+
+		auto random_id = [&] { return ids[rand() % ids.size()]; };
+		bench::ReportLatency("Draw(id) of a random layer", bench::Measure(kIterations, [&] {
+			manager.Draw(random_id());
+		}));
+		bench::ReportLatency("UpDown(id, top)", bench::Measure(kIterations, [&] {
+			manager.UpDown(random_id(), num_layers + 1);
+		}));
+		bench::ReportLatency("FindLayerByPosition", bench::Measure(kIterations, [&] {
+			bench::DoNotOptimize(manager.FindLayerByPosition(RandomPosition()));
+		}));
+		bench::ReportLatency("MoveRelative + Flush (drag frame)", bench::Measure(kIterations, [&] {
+			manager.MoveRelative(last_layer->ID(), {rand() % 7 - 3, rand() % 7 - 3});
+			manager.Flush();
+		}));
+		const auto& stats = manager.LastPresentStats();
+		printf("    last drag frame presented %zu rects, %.1f KiB\n", stats.rects, stats.bytes / 1024.0);
+
+		// mouse.cppと同じく、ドラッグ中のレイヤを半透明にして、すぐ下に影のレイヤを置く
+		const auto drag_id = last_layer->ID();
+		manager.SetOpacity(drag_id, 192);
+		auto shadow_window = std::make_shared<Window>(kWindowWidth, kWindowHeight, config.pixel_format);
+		shadow_window->SetAlphaBlending(true);
+		DrawDropShadow(*shadow_window);
+		const auto shadow_id = manager.NewLayer()
+			.SetWindow(shadow_window)
+			.Move(last_layer->GetPosition() + Vector2D<int>{6, 6})
+			.ID();
+		manager.UpDown(shadow_id, last_layer->Height());
+		manager.Flush();
+		bench::ReportLatency("drag frame with opacity + drop shadow", bench::Measure(kIterations, [&] {
+			const Vector2D<int> diff{rand() % 7 - 3, rand() % 7 - 3};
+			manager.MoveRelative(shadow_id, diff);
+			manager.MoveRelative(drag_id, diff);
+			manager.Flush();
+		}));
+		printf("    last drag frame presented %zu rects, %.1f KiB\n", stats.rects, stats.bytes / 1024.0);
+		manager.RemoveLayer(shadow_id);
+		manager.SetOpacity(drag_id, 255);
+		bench::ReportLatency("RemoveLayer + NewLayer + UpDown", bench::Measure(kIterations, [&] {
+			const size_t i = rand() % ids.size();
+			manager.RemoveLayer(ids[i]);
+			auto new_window = std::make_shared<Window>(kWindowWidth, kWindowHeight, config.pixel_format);
+			ids[i] = manager.NewLayer().SetWindow(new_window).Move(RandomPosition()).ID();
+			manager.UpDown(ids[i], rand() % (num_layers + 1) + 1);
+		}));
+	}
+
+	/**
+	 * @brief 半透明のレイヤをDraw(id)で2回描いても画面が変わらないことを確かめる
+	 *
+	 * 背景の上に不透明度192のレイヤと、ピクセルごとのアルファ値を持つレイヤを重ねて調べる
+	 */
+	bool CheckBlendedRedraw(bool tiled) {
+		FrameBufferConfig config{};
+		config.horizontal_resolution = 320;
+		config.vertical_resolution = 240;
+		config.pixel_format = kPixelBGRResv8BitPerColor;
+		FrameBuffer screen;
+		screen.Initialize(config);
+
+		LayerManager manager;
+		manager.SetWriter(&screen);
+		manager.SetTiledComposition(tiled);
+
+		auto bgwindow = std::make_shared<Window>(320, 240, config.pixel_format);
+		bgwindow->FillRect({0, 0}, {320, 240}, {0x20, 0x40, 0x60});
+		manager.UpDown(manager.NewLayer().SetWindow(bgwindow).ID(), 0);
+
+		auto faded_window = std::make_shared<Window>(kWindowWidth, kWindowHeight, config.pixel_format);
+		faded_window->FillRect({0, 0}, {kWindowWidth, kWindowHeight}, {0xe0, 0x80, 0x10});
+		const auto faded = manager.NewLayer().SetWindow(faded_window).Move({40, 30}).ID();
+		manager.UpDown(faded, 1);
+		manager.SetOpacity(faded, 192);
+
+		auto alpha_window = std::make_shared<Window>(kWindowWidth, kWindowHeight, config.pixel_format);
+		alpha_window->SetAlphaBlending(true);
+		alpha_window->FillRect({0, 0}, {kWindowWidth, kWindowHeight}, {0x10, 0xc0, 0x40, 0x60});
+		const auto alpha = manager.NewLayer().SetWindow(alpha_window).Move({90, 60}).ID();
+		manager.UpDown(alpha, 2);
+
+		manager.Draw({{0, 0}, {320, 240}});
+		manager.Present();
+		const std::vector<uint32_t> expected(screen.PixelAddr({0, 0}), screen.PixelAddr({0, 240}));
+		for (auto id : {faded, alpha, faded, alpha}) {
+			manager.Draw(id);
+			manager.Present();
+		}
+		return std::equal(expected.begin(), expected.end(), screen.PixelAddr({0, 0}));
+	}
+}
+
+int main() {
+	for (bool tiled : {false, true}) {
+		if (!CheckBlendedRedraw(tiled)) {
+			printf("Draw(id) of a blended layer changed the screen (%s composition)\n",
+				   tiled ? "tiled" : "whole-stack");
+			return 1;
+		}
+	}
+
+	for (int num_layers : {3, 100, 300, 1000}) {
+		Run(num_layers, false);
+		Run(num_layers, true);
+	}
+	return 0;
+}
@@ -0,0 +1,10 @@
+/**
+ * @file log_stub.cpp
+ *
+ * logger.cppをリンクしないベンチマーク用のLog。何も出力しない
+ */
+#include "logger.hpp"
+
+int Log(LogLevel level, const char* format, ...) {
+	return 0;
+}
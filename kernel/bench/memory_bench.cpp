@@ -0,0 +1,211 @@
+/**
+ * @file memory_bench.cpp
+ *
+ * 断片化した状態でのフレームの割り当てと解放を再生し、メモリ管理の実装ごとに速さと断片化を比べる
+ */
+#include <sys/mman.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bench.hpp"
+#include "buddy_memory_manager.hpp"
+#include "memory_manager.hpp"
+
+namespace {
+	// 扱うメモリ範囲は16GiBからの1GiB
+	// BuddyMemoryManagerはフレームIDと同じアドレスに書き込むので、この範囲をホストのアドレス空間に確保する
+	// 始点はホストのヒープがランダムに置かれる範囲より上にする
+	const size_t kRangeBegin = 16_GiB / kBytesPerFrame, kRangeEnd = kRangeBegin + 1_GiB / kBytesPerFrame;
+	// 再生する割り当てと解放の回数
+	const int kOperations = 200000;
+	// 使用中のフレームがこの割合を超えている間は解放し、下回っている間は割り当てる
+	const double kTargetUsage = 0.75;
+
+	/**
+	 * @brief 最初の実装と同じく、始点から1フレームずつビットを調べるファーストフィットの管理
+	 */
+	class LinearMemoryManager {
+	public:
+		LinearMemoryManager() : alloc_map_(kRangeEnd / 64 + 1, 0) {}
+
+		WithError<FrameID> Allocate(size_t num_frames) {
+			size_t start_frame_id = kRangeBegin;
+			while (true) {
+				size_t i = 0;
+				for (; i < num_frames; ++i) {
+					if (start_frame_id + i >= kRangeEnd) {
+						return {kNullFrame, MAKE_ERROR(Error::kNoEnoughMemory)};
+					}
+					if (GetBit(start_frame_id + i)) {
+						break;
+					}
+				}
+				if (i == num_frames) {
+					for (i = 0; i < num_frames; ++i) {
+						SetBit(start_frame_id + i, true);
+					}
+					return {FrameID{start_frame_id}, MAKE_ERROR(Error::kSuccess)};
+				}
+				start_frame_id += i + 1;
+			}
+		}
+
+		Error Free(FrameID start_frame, size_t num_frames) {
+			for (size_t i = 0; i < num_frames; ++i) {
+				SetBit(start_frame.ID() + i, false);
+			}
+			return MAKE_ERROR(Error::kSuccess);
+		}
+
+	private:
+		std::vector<uint64_t> alloc_map_;
+
+		bool GetBit(size_t frame) const {
+			return (alloc_map_[frame / 64] >> (frame % 64)) & 1;
+		}
+
+		void SetBit(size_t frame, bool allocated) {
+			const uint64_t mask = static_cast<uint64_t>(1) << (frame % 64);
+			alloc_map_[frame / 64] = allocated ? alloc_map_[frame / 64] | mask : alloc_map_[frame / 64] & ~mask;
+		}
+	};
+
+	/**
+	 * @brief 再生用の擬似乱数(xorshift64)。実装ごとに同じ列を作る
+	 */
+	class Random {
+	public:
+		uint64_t Next() {
+			state_ ^= state_ << 13;
+			state_ ^= state_ >> 7;
+			state_ ^= state_ << 17;
+			return state_;
+		}
+
+	private:
+		uint64_t state_{0x2545f4914f6cdd1dull};
+	};
+
+	/**
+	 * @brief 1回の割り当てで要求するフレーム数を選ぶ
+	 *
+	 * 7割はページテーブルなどの1フレーム、残りはバッファ用の数フレームと、DMA領域などの数百フレーム
+	 */
+	size_t PickSize(Random& random) {
+		const uint64_t r = random.Next() % 100;
+		if (r < 70) {
+			return 1;
+		} else if (r < 95) {
+			return 2 + random.Next() % 15;
+		}
+		return 64 + random.Next() % 449;
+	}
+
+	struct Block {
+		size_t start, num_frames;
+	};
+
+	struct ReplayResult {
+		// 1回あたりの秒数
+		double seconds;
+		size_t failures;
+		size_t largest_run;
+	};
+
+	/**
+	 * @brief managerが1フレームずつ以外に確保できる最大の連続フレーム数を調べる
+	 */
+	template <typename Manager>
+	size_t LargestRun(Manager& manager) {
+		size_t low = 0, high = kRangeEnd - kRangeBegin + 1;
+		while (high - low > 1) {
+			const size_t n = (low + high) / 2;
+			auto result = manager.Allocate(n);
+			if (result.error) {
+				high = n;
+			} else {
+				manager.Free(result.value, n);
+				low = n;
+			}
+		}
+		return low;
+	}
+
+	/**
+	 * @brief 使用率をkTargetUsage付近に保ちながら、割り当てと解放をoperations回繰り返す
+	 *
+	 * 解放するブロックは使用中のブロックから無作為に選ぶので、空き領域は次第に細切れになる
+	 */
+	template <typename Manager>
+	ReplayResult Replay(Manager& manager, int operations) {
+		Random random;
+		std::vector<Block> live;
+		size_t used_frames = 0, failures = 0;
+		const size_t target = static_cast<size_t>((kRangeEnd - kRangeBegin) * kTargetUsage);
+
+		const auto start = std::chrono::steady_clock::now();
+		// 割り当てに失敗したら、使用率が目標より低くても次は解放する
+		// そうしないと失敗した大きさの要求が通るまで割り当てだけが続き、細切れの空きを使い切ってしまう
+		bool failed = false;
+		for (int op = 0; op < operations; ++op) {
+			if ((used_frames < target && !failed) || live.empty()) {
+				const size_t n = PickSize(random);
+				auto result = manager.Allocate(n);
+				failed = result.error;
+				if (failed) {
+					++failures;
+					continue;
+				}
+				live.push_back({result.value.ID(), n});
+				used_frames += n;
+			} else {
+				const size_t i = random.Next() % live.size();
+				manager.Free(FrameID{live[i].start}, live[i].num_frames);
+				used_frames -= live[i].num_frames;
+				live[i] = live.back();
+				live.pop_back();
+				failed = false;
+			}
+		}
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		return {elapsed.count() / operations, failures, LargestRun(manager)};
+	}
+
+	void Report(const char* name, const ReplayResult& result) {
+		printf("  %-36s %8.3f us/op  %6zu failures  largest run %zu frames\n",
+			   name, result.seconds * 1e6, result.failures, result.largest_run);
+	}
+}
+
+int main() {
+	printf("Fragmentation replay: %d operations, %.0f%% of %zu frames in use\n",
+		   kOperations, kTargetUsage * 100, kRangeEnd - kRangeBegin);
+
+	// 空きブロックに書き込んだページだけが実際に割り当てられる
+	void* const frames = mmap(reinterpret_cast<void*>(kRangeBegin * kBytesPerFrame),
+							  (kRangeEnd - kRangeBegin) * kBytesPerFrame, PROT_READ | PROT_WRITE,
+							  MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | MAP_NORESERVE, -1, 0);
+	if (frames == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	auto linear = std::make_unique<LinearMemoryManager>();
+	Report("linear first-fit (original)", Replay(*linear, kOperations));
+
+	auto bitmap = std::make_unique<BitmapMemoryManager>();
+	bitmap->SetMemoryRange(FrameID{kRangeBegin}, FrameID{kRangeEnd});
+	Report("BitmapMemoryManager", Replay(*bitmap, kOperations));
+	const auto& stats = bitmap->CacheStats();
+	printf("    frame cache: %lu hits, %lu misses, %lu refills (%lu frames, %.0f cycles each), %lu flushed\n",
+		   stats.hits, stats.misses, stats.refills, stats.refilled_frames,
+		   static_cast<double>(stats.refill_cycles) / stats.refills, stats.flushed_frames);
+
+	// バディシステムはすべて使用中の状態から始まるので、範囲全体を解放してから使う
+	auto buddy = std::make_unique<BuddyMemoryManager>();
+	buddy->Free(FrameID{kRangeBegin}, kRangeEnd - kRangeBegin);
+	Report("BuddyMemoryManager", Replay(*buddy, kOperations));
+	return 0;
+}
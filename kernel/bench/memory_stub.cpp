@@ -0,0 +1,9 @@
+/**
+ * @file memory_stub.cpp
+ *
+ * newlib_support.cをリンクしないベンチマーク用に、memory_manager.cppが参照するプログラムブレークだけを用意する
+ */
+#include <sys/types.h>
+
+extern "C" caddr_t program_break, program_break_end;
+caddr_t program_break, program_break_end;
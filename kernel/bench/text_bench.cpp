@@ -0,0 +1,81 @@
+/**
+ * @file text_bench.cpp
+ *
+ * コンソールの1画面分の文字列を描画する速さを、描き方ごとに1秒あたりの文字数で比べる
+ */
+#include <cstring>
+
+#include "bench.hpp"
+#include "font.hpp"
+#include "window.hpp"
+
+const uint8_t* GetFont(char c);
+
+namespace {
+	const int kColumns = 80, kRows = 25;
+	const int kIterations = 2000;
+	const PixelColor kFgColor{255, 255, 255};
+	const PixelColor kBgColor{0, 0, 0};
+
+	/**
+	 * @brief 以前の実装と同じく、ビットが立っているピクセルを1つずつ書く
+	 */
+	void WriteAsciiPerPixel(PixelWriter& writer, Vector2D<int> pos, char c, const PixelColor& color) {
+		const uint8_t* font = GetFont(c);
+		if (font == nullptr) {
+			return;
+		}
+		for (int dy = 0; dy < 16; ++dy) {
+			for (int dx = 0; dx < 8; ++dx) {
+				if ((font[dy] << dx) & 0x80u) {
+					writer.Write(pos + Vector2D<int>{dx, dy}, color);
+				}
+			}
+		}
+	}
+}
+
+int main() {
+	Window window{8 * kColumns, 16 * kRows, kPixelBGRResv8BitPerColor};
+	auto& writer = *window.Writer();
+
+	// ログらしい、英数字と記号の混ざった行を用意する
+	char lines[kRows][kColumns + 1];
+	const char* sample = "[kDebug] xhci: port 3 status 0x00201203, slot=2 ep=1 len=8; ";
+	const size_t sample_len = strlen(sample);
+	for (int row = 0; row < kRows; ++row) {
+		for (int col = 0; col < kColumns; ++col) {
+			lines[row][col] = sample[(row * 7 + col) % sample_len];
+		}
+		lines[row][kColumns] = '\0';
+	}
+
+	auto measure = [&](auto draw_line) {
+		return bench::Measure(kIterations, [&] {
+			for (int row = 0; row < kRows; ++row) {
+				draw_line(Vector2D<int>{0, 16 * row}, lines[row]);
+			}
+			bench::DoNotOptimize(window);
+		});
+	};
+	auto clear = [&](Vector2D<int> pos) {
+		FillRectangle(writer, pos, {8 * kColumns, 16}, kBgColor);
+	};
+
+	printf("Text rendering, %dx%d characters per iteration into a window\n", kColumns, kRows);
+	const double chars = kColumns * kRows;
+	bench::ReportRate("fill + per-pixel glyphs (old)", measure([&](Vector2D<int> pos, const char* s) {
+		clear(pos);
+		for (int i = 0; s[i] != '\0'; ++i) {
+			WriteAsciiPerPixel(writer, pos + Vector2D<int>{8 * i, 0}, s[i], kFgColor);
+		}
+	}), chars, "chars");
+	bench::ReportRate("fill + span glyphs", measure([&](Vector2D<int> pos, const char* s) {
+		clear(pos);
+		WriteString(writer, pos, s, kFgColor);
+	}), chars, "chars");
+	bench::ReportRate("glyph cache, fg + bg rows", measure([&](Vector2D<int> pos, const char* s) {
+		WriteString(writer, pos, s, kFgColor, kBgColor);
+	}), chars, "chars");
+	return 0;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file blit.cpp
+ *
+ * x86-64ではSSE2が必ず使えるので、実行時の判定なしにSSE2命令を使う
+ * AVX2はXCR0でAVX状態を有効にしないと使えないが、カーネルはまだ有効にしていないので使わない
+ * 割り込みハンドラ(__attribute__((interrupt)))は使用するXMMレジスタを自分で退避するので、
+ * ここでXMMレジスタを使っても割り込みによって値が壊れることはない
+ */
+#include "blit.hpp"
+
+#include <algorithm>
+#include <emmintrin.h>
+
+namespace {
+	// 1回のループで処理するピクセル数(16バイト x 4)
+	const size_t kPixelsPerBlock = 16;
+
+	// ピクセル値のうち色を表す部分
+	const uint32_t kColorMask = 0x00ffffffu;
+
+	// ピクセル値のうちアルファ値を表す部分
+	const uint32_t kAlphaMask = 0xff000000u;
+
+	void CopyTail(uint32_t* dst, const uint32_t* src, size_t num_pixels) {
+		for (size_t i = 0; i < num_pixels; ++i) {
+			dst[i] = src[i];
+		}
+	}
+
+	/**
+	 * @brief 0〜255*255の値を255で割って四捨五入する
+	 */
+	inline unsigned int Div255(unsigned int x) {
+		x += 128;
+		return (x + (x >> 8)) >> 8;
+	}
+
+	/**
+	 * @brief 16ビット整数の各要素についてDiv255を計算する
+	 */
+	inline __m128i Div255Epi16(__m128i x) {
+		x = _mm_add_epi16(x, _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+	}
+
+	/**
+	 * @brief 16ビット整数に展開した2ピクセル分を合成する
+	 */
+	inline __m128i Blend2Pixels(__m128i s, __m128i d, __m128i opacity) {
+		s = Div255Epi16(_mm_mullo_epi16(s, opacity));
+		// 各ピクセルのアルファ値を4つの要素すべてに配る
+		__m128i alpha = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+		alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+		const __m128i inv_alpha = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+		return _mm_add_epi16(s, Div255Epi16(_mm_mullo_epi16(d, inv_alpha)));
+	}
+
+	uint32_t BlendPixel(uint32_t d, uint32_t s, unsigned int opacity) {
+		const unsigned int alpha = Div255((s >> 24) * opacity);
+		uint32_t result = 0;
+		for (int shift = 0; shift < 32; shift += 8) {
+			const unsigned int sc = Div255(((s >> shift) & 0xff) * opacity);
+			const unsigned int dc = Div255(((d >> shift) & 0xff) * (255 - alpha));
+			result |= std::min(sc + dc, 255u) << shift;
+		}
+		return result;
+	}
+}
+
+void CopyPixels32(uint32_t* dst, const uint32_t* src, size_t num_pixels) {
+	size_t i = 0;
+	for (; i + kPixelsPerBlock <= num_pixels; i += kPixelsPerBlock) {
+		auto s = reinterpret_cast<const __m128i*>(src + i);
+		auto d = reinterpret_cast<__m128i*>(dst + i);
+		const __m128i x0 = _mm_loadu_si128(s + 0);
+		const __m128i x1 = _mm_loadu_si128(s + 1);
+		const __m128i x2 = _mm_loadu_si128(s + 2);
+		const __m128i x3 = _mm_loadu_si128(s + 3);
+		_mm_storeu_si128(d + 0, x0);
+		_mm_storeu_si128(d + 1, x1);
+		_mm_storeu_si128(d + 2, x2);
+		_mm_storeu_si128(d + 3, x3);
+	}
+	for (; i + 4 <= num_pixels; i += 4) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+						 _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+	}
+	CopyTail(dst + i, src + i, num_pixels - i);
+}
+
+void StreamPixels32(uint32_t* dst, const uint32_t* src, size_t num_pixels) {
+	// movntdqは書き込み先が16バイト境界に揃っている必要があるので、先頭の端数は通常のストアで書く
+	size_t head = (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) / 4 & 3;
+	if (head > num_pixels) {
+		head = num_pixels;
+	}
+	CopyTail(dst, src, head);
+
+	size_t i = head;
+	for (; i + kPixelsPerBlock <= num_pixels; i += kPixelsPerBlock) {
+		auto s = reinterpret_cast<const __m128i*>(src + i);
+		auto d = reinterpret_cast<__m128i*>(dst + i);
+		const __m128i x0 = _mm_loadu_si128(s + 0);
+		const __m128i x1 = _mm_loadu_si128(s + 1);
+		const __m128i x2 = _mm_loadu_si128(s + 2);
+		const __m128i x3 = _mm_loadu_si128(s + 3);
+		_mm_stream_si128(d + 0, x0);
+		_mm_stream_si128(d + 1, x1);
+		_mm_stream_si128(d + 2, x2);
+		_mm_stream_si128(d + 3, x3);
+	}
+	for (; i + 4 <= num_pixels; i += 4) {
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst + i),
+						 _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+	}
+	CopyTail(dst + i, src + i, num_pixels - i);
+}
+
+void CopyPixelsKeyed32(uint32_t* dst, const uint32_t* src, size_t num_pixels, uint32_t key) {
+	const __m128i color_mask = _mm_set1_epi32(kColorMask);
+	const __m128i key4 = _mm_set1_epi32(key & kColorMask);
+
+	size_t i = 0;
+	for (; i + 4 <= num_pixels; i += 4) {
+		auto d = reinterpret_cast<__m128i*>(dst + i);
+		const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		// 透過するピクセルの位置が全ビット1になる
+		const __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(s, color_mask), key4);
+		const int bits = _mm_movemask_epi8(transparent);
+		if (bits == 0xffff) {
+			continue;
+		}
+		if (bits == 0) {
+			// 4ピクセルとも不透明ならコピー先を読む必要はない
+			_mm_storeu_si128(d, s);
+			continue;
+		}
+		const __m128i old = _mm_loadu_si128(d);
+		_mm_storeu_si128(d, _mm_or_si128(_mm_andnot_si128(transparent, s),
+										 _mm_and_si128(transparent, old)));
+	}
+	for (; i < num_pixels; ++i) {
+		if ((src[i] & kColorMask) != (key & kColorMask)) {
+			dst[i] = src[i];
+		}
+	}
+}
+
+void BlendPixels32(uint32_t* dst, const uint32_t* src, size_t num_pixels,
+				   uint8_t opacity, bool src_has_alpha) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha_mask = _mm_set1_epi32(kAlphaMask);
+	const __m128i force_alpha = src_has_alpha ? zero : alpha_mask;
+	const __m128i opacity16 = _mm_set1_epi16(opacity);
+
+	size_t i = 0;
+	for (; i + 4 <= num_pixels; i += 4) {
+		auto d = reinterpret_cast<__m128i*>(dst + i);
+		const __m128i s = _mm_or_si128(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), force_alpha);
+		const __m128i s_alpha = _mm_and_si128(s, alpha_mask);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(s_alpha, zero)) == 0xffff) {
+			// 4ピクセルとも完全に透明
+			continue;
+		}
+		if (opacity == 255 &&
+				_mm_movemask_epi8(_mm_cmpeq_epi32(s_alpha, alpha_mask)) == 0xffff) {
+			// 4ピクセルとも完全に不透明
+			_mm_storeu_si128(d, s);
+			continue;
+		}
+
+		const __m128i old = _mm_loadu_si128(d);
+		const __m128i lo = Blend2Pixels(_mm_unpacklo_epi8(s, zero),
+										_mm_unpacklo_epi8(old, zero), opacity16);
+		const __m128i hi = Blend2Pixels(_mm_unpackhi_epi8(s, zero),
+										_mm_unpackhi_epi8(old, zero), opacity16);
+		_mm_storeu_si128(d, _mm_packus_epi16(lo, hi));
+	}
+
+	const uint32_t force_alpha32 = src_has_alpha ? 0 : kAlphaMask;
+	for (; i < num_pixels; ++i) {
+		dst[i] = BlendPixel(dst[i], src[i] | force_alpha32, opacity);
+	}
+}
+
+void FillPixels32(uint32_t* dst, uint32_t value, size_t num_pixels) {
+	const __m128i v = _mm_set1_epi32(value);
+	size_t i = 0;
+	for (; i + kPixelsPerBlock <= num_pixels; i += kPixelsPerBlock) {
+		auto d = reinterpret_cast<__m128i*>(dst + i);
+		_mm_storeu_si128(d + 0, v);
+		_mm_storeu_si128(d + 1, v);
+		_mm_storeu_si128(d + 2, v);
+		_mm_storeu_si128(d + 3, v);
+	}
+	for (; i + 4 <= num_pixels; i += 4) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+	}
+	for (; i < num_pixels; ++i) {
+		dst[i] = value;
+	}
+}
+
+void StoreFence() {
+	_mm_sfence();
+}
@@ -0,0 +1,52 @@
+/**
+ * @file blit.hpp
+ *
+ * 32ビットピクセルの配列を高速にコピーする関数群
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 32ビットピクセルをnum_pixels個コピーする。コピー元とコピー先は重なってはならない
+ *
+ * SSE2の16バイト単位のロード・ストアでコピーする。メインメモリ上のバッファ間のコピーに使う
+ */
+void CopyPixels32(uint32_t* dst, const uint32_t* src, size_t num_pixels);
+
+/**
+ * @brief 32ビットピクセルをnum_pixels個、キャッシュを経由せずにコピーする
+ *
+ * 非テンポラルストア(movntdq)で書き込むので、書き込んだ後に読み返さないVRAMへの転送に向く
+ * 一連の転送が終わったら、他の書き込みと順序を揃えるためにStoreFenceを呼ぶこと
+ */
+void StreamPixels32(uint32_t* dst, const uint32_t* src, size_t num_pixels);
+
+/**
+ * @brief 色がkeyと一致するピクセルを飛ばしながら、32ビットピクセルをnum_pixels個コピーする
+ *
+ * 比較は下位24ビット(色の部分)だけで行い、予約領域の8ビットは無視する
+ * 4ピクセルずつSIMD命令で比較し、コピー先の値とマスク合成する
+ */
+void CopyPixelsKeyed32(uint32_t* dst, const uint32_t* src, size_t num_pixels, uint32_t key);
+
+/**
+ * @brief srcをdstの上にアルファ合成する
+ *
+ * srcの各ピクセルは上位8ビットをアルファ値とし、色はアルファ値を乗算済み(premultiplied)とする
+ * src_has_alphaがfalseなら、srcのアルファ値はすべて255とみなす
+ * さらにsrc全体にopacity/255を掛けてから合成する。計算は16ビット整数のSIMD命令で2ピクセルずつ行う
+ */
+void BlendPixels32(uint32_t* dst, const uint32_t* src, size_t num_pixels,
+				   uint8_t opacity, bool src_has_alpha);
+
+/**
+ * @brief num_pixels個のピクセルをすべてvalueで埋める
+ */
+void FillPixels32(uint32_t* dst, uint32_t value, size_t num_pixels);
+
+/**
+ * @brief 非テンポラルストアがメモリに反映されるのを待つ
+ */
+void StoreFence();
@@ -0,0 +1,196 @@
+/**
+ * @file buddy_memory_manager.cpp
+ */
+#include "buddy_memory_manager.hpp"
+
+#include <algorithm>
+
+namespace {
+	/**
+	 * @brief num_frames個以下で最大の2のべき乗の指数を返す
+	 */
+	int FloorLog2(size_t num_frames) {
+		return 8 * sizeof(unsigned long) - 1 - __builtin_clzl(num_frames);
+	}
+
+	/**
+	 * @brief num_frames個以上で最小の2のべき乗の指数を返す
+	 */
+	int CeilLog2(size_t num_frames) {
+		return num_frames <= 1 ? 0 : FloorLog2(num_frames - 1) + 1;
+	}
+}
+
+WithError<FrameID> BuddyMemoryManager::Allocate(size_t num_frames) {
+	if (num_frames == 0 || num_frames > (static_cast<size_t>(1) << kMaxOrder)) {
+		return {kNullFrame, MAKE_ERROR(Error::kNoEnoughMemory)};
+	}
+
+	// 空きリストの先頭ではなく最もアドレスの低いブロックを使い、小さな割り当てを低いアドレスに寄せる
+	// 先頭から取ると解放直後の断片が再利用され続け、バディの結合が妨げられて大きなブロックが残らない
+	const int order = CeilLog2(num_frames);
+	const size_t frame = LowestFreeBlock(order);
+	if (frame == kFrameCount) {
+		return {kNullFrame, MAKE_ERROR(Error::kNoEnoughMemory)};
+	}
+	int found_order = RemoveBlock(frame);
+
+	// 大きすぎるブロックは半分に分け、後ろ半分を空きリストに戻していく
+	while (found_order > order) {
+		--found_order;
+		PushBlock(frame + (static_cast<size_t>(1) << found_order), found_order);
+	}
+	// 2のべき乗に切り上げた分は使わないので空きに戻す
+	FreeRange(frame + num_frames, frame + (static_cast<size_t>(1) << order));
+
+	return {
+		FrameID{frame},
+		MAKE_ERROR(Error::kSuccess),
+	};
+}
+
+Error BuddyMemoryManager::Free(FrameID start_frame, size_t num_frames) {
+	// フレーム0はヌルポインタと区別できないので扱わない
+	const size_t begin = std::max<size_t>(start_frame.ID(), 1);
+	const size_t end = std::min<size_t>(start_frame.ID() + num_frames, kFrameCount);
+	if (begin < end) {
+		FreeRange(begin, end);
+	}
+	return MAKE_ERROR(Error::kSuccess);
+}
+
+void BuddyMemoryManager::MarkAllocated(FrameID start_frame, size_t num_frames) {
+	const size_t end = std::min<size_t>(start_frame.ID() + num_frames, kFrameCount);
+	size_t frame = start_frame.ID();
+	while (frame < end) {
+		// frameを含む空きブロックを、小さいオーダーから順に探す
+		int order = 0;
+		size_t head = frame;
+		for (; order <= kMaxOrder; ++order) {
+			head = frame & ~((static_cast<size_t>(1) << order) - 1);
+			if (IsFreeBlock(head, order)) {
+				break;
+			}
+		}
+
+		if (order > kMaxOrder) {
+			// frameは使用中。この先で最初の空きブロックまで進む
+			frame = NextFreeHead(frame + 1, end);
+			continue;
+		}
+
+		// ブロックを外し、マークする範囲からはみ出した前後の部分だけを空きに戻す
+		RemoveBlock(head);
+		const size_t block_end = head + (static_cast<size_t>(1) << order);
+		FreeRange(head, frame);
+		FreeRange(end, block_end);
+		frame = block_end;
+	}
+}
+
+void BuddyMemoryManager::SetMemoryRange(FrameID range_begin, FrameID range_end) {
+	MarkAllocated(FrameID{0}, range_begin.ID());
+	if (range_end.ID() < kFrameCount) {
+		MarkAllocated(range_end, kFrameCount - range_end.ID());
+	}
+}
+
+BuddyMemoryManager::FreeNode* BuddyMemoryManager::Node(size_t frame) {
+	return reinterpret_cast<FreeNode*>(frame * kBytesPerFrame);
+}
+
+bool BuddyMemoryManager::IsFreeHead(size_t frame) const {
+	return (free_heads_[frame / kBitsPerMapLine] >> (frame % kBitsPerMapLine)) & 1;
+}
+
+bool BuddyMemoryManager::IsFreeBlock(size_t frame, int order) const {
+	return IsFreeHead(frame) && Node(frame)->order == order;
+}
+
+void BuddyMemoryManager::PushBlock(size_t frame, int order) {
+	auto node = Node(frame);
+	node->order = order;
+	node->prev = nullptr;
+	node->next = free_lists_[order];
+	if (node->next) {
+		node->next->prev = node;
+	}
+	free_lists_[order] = node;
+	lowest_free_head_ = std::min(lowest_free_head_, frame);
+	free_heads_[frame / kBitsPerMapLine] |= static_cast<MapLineType>(1) << (frame % kBitsPerMapLine);
+}
+
+int BuddyMemoryManager::RemoveBlock(size_t frame) {
+	auto node = Node(frame);
+	if (node->prev) {
+		node->prev->next = node->next;
+	} else {
+		free_lists_[node->order] = node->next;
+	}
+	if (node->next) {
+		node->next->prev = node->prev;
+	}
+	free_heads_[frame / kBitsPerMapLine] &= ~(static_cast<MapLineType>(1) << (frame % kBitsPerMapLine));
+	return node->order;
+}
+
+void BuddyMemoryManager::FreeBlock(size_t frame, int order) {
+	while (order < kMaxOrder) {
+		const size_t buddy = frame ^ (static_cast<size_t>(1) << order);
+		if (buddy == 0 || buddy >= kFrameCount || !IsFreeBlock(buddy, order)) {
+			break;
+		}
+		RemoveBlock(buddy);
+		frame = std::min(frame, buddy);
+		++order;
+	}
+	PushBlock(frame, order);
+}
+
+void BuddyMemoryManager::FreeRange(size_t begin, size_t end) {
+	while (begin < end) {
+		// beginの位置に揃っていて、endを超えない最大のブロックを切り出す
+		int order = std::min(FloorLog2(end - begin), kMaxOrder);
+		if (begin != 0) {
+			order = std::min(order, __builtin_ctzl(begin));
+		}
+		FreeBlock(begin, order);
+		begin += static_cast<size_t>(1) << order;
+	}
+}
+
+size_t BuddyMemoryManager::LowestFreeBlock(int order) {
+	// order以上の空きブロックがなければ探すまでもない
+	int o = order;
+	while (o <= kMaxOrder && free_lists_[o] == nullptr) {
+		++o;
+	}
+	if (o > kMaxOrder) {
+		return kFrameCount;
+	}
+
+	lowest_free_head_ = NextFreeHead(lowest_free_head_, kFrameCount);
+	// オーダーorder以上のブロックは2^order個のフレーム単位に揃っているので、揃っていない先頭は調べない
+	const size_t mask = (static_cast<size_t>(1) << order) - 1;
+	size_t frame = NextFreeHead((lowest_free_head_ + mask) & ~mask, kFrameCount);
+	while (frame < kFrameCount && ((frame & mask) != 0 || Node(frame)->order < order)) {
+		frame = NextFreeHead(((frame + 1) + mask) & ~mask, kFrameCount);
+	}
+	return frame;
+}
+
+size_t BuddyMemoryManager::NextFreeHead(size_t frame, size_t limit) const {
+	if (frame >= limit) {
+		return limit;
+	}
+	size_t line = frame / kBitsPerMapLine;
+	MapLineType bits = free_heads_[line] & (~static_cast<MapLineType>(0) << (frame % kBitsPerMapLine));
+	while (bits == 0) {
+		++line;
+		if (line * kBitsPerMapLine >= limit) {
+			return limit;
+		}
+		bits = free_heads_[line];
+	}
+	return std::min(line * kBitsPerMapLine + __builtin_ctzl(bits), limit);
+}
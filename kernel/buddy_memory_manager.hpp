@@ -0,0 +1,131 @@
+/**
+ * @file buddy_memory_manager.hpp
+ *
+ * バディシステムによる物理フレームの管理
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "memory_manager.hpp"
+#include "paging.hpp"
+
+/**
+ * @brief バディシステムでメモリフレームの空き状況を管理するクラス
+ *
+ * 空き領域を2のべき乗個のフレームからなる、大きさに揃った位置のブロックに分け、
+ * ブロックの大きさ(オーダー)ごとの空きリストで管理する。解放したブロックは、
+ * 隣の同じ大きさのブロック(バディ)も空いていれば結合して1つ大きなブロックにする。
+ * 空きリストのノードは空きブロックの先頭フレーム自体に置くので、ノードを書き込める
+ * 恒等マッピング済みの範囲(kPageDirectoryCount GiB)だけを扱う。
+ *
+ * 初期状態ではすべてのフレームが使用中で、Freeで渡された領域が空きとして登録される。
+ * BitmapMemoryManagerと同じインターフェースを持ち、ビルド時にどちらかを選ぶ。
+ */
+class BuddyMemoryManager {
+public:
+	// このメモリ管理クラスで扱える最大の物理メモリ量(バイト)
+	static const auto kMaxPhysicalMemoryBytes{kPageDirectoryCount * 1_GiB};
+	// kMaxPhysicalMemoryBytesまでの物理メモリを扱うために必要なフレーム数
+	static const auto kFrameCount{kMaxPhysicalMemoryBytes / kBytesPerFrame};
+	// 最大のオーダー。ブロックは最大で2^kMaxOrder個のフレームからなる
+	static constexpr int kMaxOrder = 24;
+
+	/**
+	 * @brief 要求されたフレーム数の領域を確保して先頭のフレームIDを返す
+	 *
+	 * num_frames以上で最小の2のべき乗の大きさのブロックを、必要なら大きなブロックを分割して取り出す。
+	 * 分割するブロックは、足りる大きさの空きブロックのうち最もアドレスの低いものを選ぶ。
+	 * ブロックのうちnum_framesを超える末尾の部分はすぐに空きに戻す。
+	 *
+	 * @param num_frames 確保したいフレーム数
+	 * @return 確保した領域の先頭フレームIDとエラー情報
+	 */
+	WithError<FrameID> Allocate(size_t num_frames);
+
+	/**
+	 * @brief 指定されたフレーム領域を解放する
+	 *
+	 * 領域を大きさに揃った位置のブロックに分け、それぞれをバディと結合しながら空きリストに戻す。
+	 *
+	 * @param start_frame 解放する領域の先頭フレーム
+	 * @param num_frames 解放するフレーム数
+	 * @return エラー情報
+	 */
+	Error Free(FrameID start_frame, size_t num_frames);
+
+	/**
+	 * @brief 指定されたフレーム領域を割り当て済みとしてマークする
+	 *
+	 * 領域と重なる空きブロックを空きリストから外し、領域からはみ出した部分だけを空きに戻す。
+	 *
+	 * @param start_frame マークする領域の先頭フレーム
+	 * @param num_frames マークするフレーム数
+	 */
+	void MarkAllocated(FrameID start_frame, size_t num_frames);
+
+	/**
+	 * @brief このメモリマネージャで扱うメモリ範囲を設定する。範囲外の空きフレームは割り当て済みとしてマークする
+	 *
+	 * @param range_begin	メモリ範囲の始点
+	 * @param range_end		メモリ範囲の終点。最終フレームの次のフレーム
+	 */
+	void SetMemoryRange(FrameID range_begin, FrameID range_end);
+
+private:
+	using MapLineType = unsigned long;
+	static const size_t kBitsPerMapLine{8 * sizeof(MapLineType)};
+
+	/**
+	 * @brief 空きブロックの先頭フレームに置く、空きリストのノード
+	 */
+	struct FreeNode {
+		FreeNode* next;
+		FreeNode* prev;
+		// このブロックのオーダー
+		int order;
+	};
+
+	// オーダーごとの空きリストの先頭
+	std::array<FreeNode*, kMaxOrder + 1> free_lists_{};
+	// 各ビットが1フレームに対応し、空きブロックの先頭フレームなら1
+	// 1のフレームに置かれたノードだけが有効なので、バディが空いているかはこのビットとノードのorderで判断する
+	std::array<MapLineType, kFrameCount / kBitsPerMapLine> free_heads_{};
+	// 空きブロックの先頭フレームはすべてこれ以降にある
+	size_t lowest_free_head_{kFrameCount};
+
+	static FreeNode* Node(size_t frame);
+	bool IsFreeHead(size_t frame) const;
+	bool IsFreeBlock(size_t frame, int order) const;
+
+	/**
+	 * @brief frameから始まるオーダーorderのブロックを空きリストに加える。結合はしない
+	 */
+	void PushBlock(size_t frame, int order);
+
+	/**
+	 * @brief frameから始まる空きブロックを空きリストから外し、そのオーダーを返す
+	 */
+	int RemoveBlock(size_t frame);
+
+	/**
+	 * @brief frameから始まるオーダーorderのブロックを、バディと結合しながら空きリストに戻す
+	 */
+	void FreeBlock(size_t frame, int order);
+
+	/**
+	 * @brief [begin, end)を大きさに揃った位置のブロックに分けて空きリストに戻す
+	 */
+	void FreeRange(size_t begin, size_t end);
+
+	/**
+	 * @brief [frame, limit)で最初の空きブロックの先頭フレームを返す。なければlimitを返す
+	 */
+	size_t NextFreeHead(size_t frame, size_t limit) const;
+
+	/**
+	 * @brief オーダーorder以上の空きブロックのうち、最もアドレスの低いものの先頭フレームを返す。なければkFrameCountを返す
+	 */
+	size_t LowestFreeBlock(int order);
+};
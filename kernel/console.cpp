@@ -3,31 +3,179 @@
  */
 #include "console.hpp"
 
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include "font.hpp"
 #include "layer.hpp"
 
 Console::Console(const PixelColor& fg_color, const PixelColor& bg_color)
 	: writer_{nullptr}, window_{}, fg_color_{fg_color}, bg_color_{bg_color},
-	  buffer_{}, cursor_row_{0}, cursor_column_{0}, layer_id_{0} {
+	  rows_{kDefaultRows}, columns_{kDefaultColumns}, default_buffer_{}, buffer_storage_{},
+	  buffer_{default_buffer_}, row_offset_{0}, cursor_row_{0}, cursor_column_{0},
+	  dirty_begin_{0}, dirty_end_{0}, scroll_pending_{0}, history_{}, view_offset_{0},
+	  layer_id_{0} {
 }
 
 void Console::PutString(const char* s) {
 	while (*s) {
 		if (*s == '\n') {
 			Newline();
-		} else if (cursor_column_ < kColumns - 1) {
-			WriteAscii(*writer_, Vector2D<int>{8 * cursor_column_, 16 * cursor_row_}, *s, fg_color_);
-			buffer_[cursor_row_][cursor_column_] = *s;
-			++cursor_column_;
+			++s;
+			continue;
 		}
-		++s;
+
+		// 改行までの文字をバッファに入れ、行を描き直しが必要なものとして記録する
+		char* line = Row(cursor_row_);
+		for (; *s && *s != '\n'; ++s) {
+			if (cursor_column_ < columns_ - 1) {
+				line[cursor_column_] = *s;
+				++cursor_column_;
+			}
+		}
+		if (cursor_row_ + view_offset_ < rows_) {
+			MarkRowDirty(cursor_row_ + view_offset_);
+		}
+	}
+
+	// ウィンドウがない起動直後は描画をまとめる契機がないので、すぐに描く
+	if (!window_) {
+		Render();
+	}
+}
+
+void Console::Render() {
+	if (scroll_pending_ != 0) {
+		if (window_ && std::abs(scroll_pending_) < rows_) {
+			window_->Scroll(16 * scroll_pending_);
+		} else {
+			MarkRowDirty(0);
+			MarkRowDirty(rows_ - 1);
+		}
+		scroll_pending_ = 0;
+	}
+
+	for (int row = dirty_begin_; row < dirty_end_; ++row) {
+		DrawRow(row);
 	}
+	dirty_begin_ = dirty_end_ = 0;
+}
+
+void Console::Flush() {
+	Render();
 	if (layer_manager) {
-		layer_manager->Draw(layer_id_);
+		layer_manager->Flush();
+	}
+}
+
+void Console::ScrollView(int lines) {
+	const int new_offset = std::clamp(view_offset_ + lines, 0, static_cast<int>(history_.Lines()));
+	const int delta = new_offset - view_offset_;
+	if (delta == 0) {
+		return;
+	}
+	// 過去へずらすと内容は下へ動く
+	view_offset_ = new_offset;
+	ScrollDisplay(-delta);
+
+	if (!window_) {
+		Render();
 	}
 }
 
+void Console::Resize(int rows, int columns) {
+	rows = std::max(rows, 1);
+	columns = std::clamp(columns, 2, kMaxColumns);
+	if (rows == rows_ && columns == columns_) {
+		return;
+	}
+
+	// 溜まっている変更を先に反映し、ウィンドウの内容と文字の内容を一致させておく
+	ScrollView(-view_offset_);
+	Render();
+
+	// カーソル行から上の各行を新しい桁数で折り返し、新しい行数に収まる下の方を引き継ぐ
+	// 収まらない上の行は履歴に移す。PutStringで書ける1行はcolumns - 1文字まで
+	const int width = columns - 1;
+	int total_rows = 0;
+	bool wrapped = false;
+	for (int row = 0; row <= cursor_row_; ++row) {
+		const int pieces = std::max<int>((strlen(Row(row)) + width - 1) / width, 1);
+		wrapped |= pieces > 1;
+		total_rows += pieces;
+	}
+	const int kept_rows = std::min(total_rows, rows);
+	const int dropped_rows = total_rows - kept_rows;
+
+	std::vector<char> new_storage(rows * (columns + 1), '\0');
+	char piece[kMaxColumns + 1];
+	int new_row = -dropped_rows;
+	for (int row = 0; row <= cursor_row_; ++row) {
+		const char* src = Row(row);
+		const int len = strlen(src);
+		int offset = 0;
+		do {
+			const int n = std::min(len - offset, width);
+			if (new_row < 0) {
+				memcpy(piece, src + offset, n);
+				piece[n] = '\0';
+				history_.Append(piece);
+			} else {
+				memcpy(&new_storage[new_row * (columns + 1)], src + offset, n);
+			}
+			++new_row;
+			offset += n;
+		} while (offset < len);
+	}
+
+	std::shared_ptr<Window> new_window;
+	if (window_) {
+		new_window = std::make_shared<Window>(columns * 8, rows * 16, screen_config.pixel_format);
+		if (!wrapped) {
+			// どの行も折り返さなければ行の並びは変わらないので、描画済みの内容を古いウィンドウから複製する
+			new_window->CopyFrom({0, 0}, *window_, {{0, 16 * dropped_rows}, {8 * columns_, 16 * kept_rows}});
+		}
+	}
+
+	const int old_columns = columns_;
+	buffer_storage_ = std::move(new_storage);
+	buffer_ = buffer_storage_.data();
+	rows_ = rows;
+	columns_ = columns;
+	row_offset_ = 0;
+	cursor_row_ = kept_rows - 1;
+	cursor_column_ = strlen(Row(cursor_row_));
+	dirty_begin_ = dirty_end_ = 0;
+	scroll_pending_ = 0;
+
+	if (!window_) {
+		Refresh();
+		return;
+	}
+
+	window_ = new_window;
+	writer_ = new_window->Writer();
+	if (wrapped) {
+		for (int row = 0; row < kept_rows; ++row) {
+			DrawRow(row);
+		}
+	} else if (columns > old_columns) {
+		FillRectangle(*writer_, {8 * old_columns, 0}, {8 * (columns - old_columns), 16 * kept_rows}, bg_color_);
+	}
+	FillRectangle(*writer_, {0, 16 * kept_rows}, {8 * columns, 16 * (rows - kept_rows)}, bg_color_);
+	if (layer_manager && layer_id_ != 0) {
+		layer_manager->SetWindow(layer_id_, new_window);
+	}
+}
+
+int Console::Rows() const {
+	return rows_;
+}
+
+int Console::Columns() const {
+	return columns_;
+}
+
 void Console::SetWriter(PixelWriter* writer) {
 	if (writer == writer_) {
 		return;
@@ -56,31 +204,83 @@ unsigned int Console::LayerID() const {
 
 void Console::Newline() {
 	cursor_column_ = 0;
-	if (cursor_row_ < kRows - 1) {
+	if (cursor_row_ < rows_ - 1) {
 		// 単純に次の行へ
 		++cursor_row_;
 		return;
 	}
 
-	if (window_) {
-		Rectangle<int> move_src{{0, 16}, {8 * kColumns, 16 * (kRows - 1)}};
-		window_->Move({0, 0}, move_src);
-		FillRectangle(*writer_, {0, 16 * (kRows - 1)}, {8 * kColumns, 16}, bg_color_);
+	// 先頭の行を履歴に移し、空けた行を最下行として使い回す。文字も画素も行を動かさずに1行分ずらす
+	const size_t history_lines = history_.Lines();
+	history_.Append(Row(0));
+	row_offset_ = (row_offset_ + 1) % rows_;
+	memset(Row(rows_ - 1), 0, columns_ + 1);
+
+	if (view_offset_ == 0) {
+		ScrollDisplay(1);
+	} else if (history_.Lines() > history_lines) {
+		// 履歴を表示している間は、同じ内容が見え続けるように表示位置も1行過去へずらす
+		++view_offset_;
 	} else {
-		FillRectangle(*writer_, {0, 0}, {8 * kColumns, 16 * kRows}, bg_color_);
-		for (int row = 0; row < kRows - 1; ++row) {
-			memcpy(buffer_[row], buffer_[row + 1], kColumns + 1);
-			WriteString(*writer_, Vector2D<int>{0, 16 * row}, buffer_[row], fg_color_);
-		}
-		memset(buffer_[kRows - 1], 0, kColumns + 1);
+		// 履歴から古い行が押し出されたので、見えている内容が変わった
+		// 押し出された行を表示していたかもしれないので、表示位置を残っている履歴の範囲に収める
+		view_offset_ = std::min(view_offset_ + 1, static_cast<int>(history_.Lines()));
+		MarkRowDirty(0);
+		MarkRowDirty(rows_ - 1);
 	}
 }
 
 void Console::Refresh() {
-	FillRectangle(*writer_, {0, 0}, {8 * kColumns, 16 * kRows}, bg_color_);
-	for (int row = 0; row < kRows; ++row) {
-		WriteString(*writer_, Vector2D<int>{0, 16 * row}, buffer_[row], fg_color_);
+	for (int row = 0; row < rows_; ++row) {
+		DrawRow(row);
 	}
+	dirty_begin_ = dirty_end_ = 0;
+	scroll_pending_ = 0;
+}
+
+void Console::DrawRow(int row) {
+	// 文字は背景ごと描き、行末までの残りは背景色で塗る。どのピクセルも1度だけ書く
+	char history_line[kMaxColumns + 1];
+	const int screen_row = row - view_offset_;
+	const char* line = history_line;
+	if (screen_row >= 0) {
+		line = Row(screen_row);
+	} else {
+		history_.GetLine(history_.Lines() + screen_row, history_line, columns_);
+	}
+	const int len = strlen(line);
+	WriteString(*writer_, Vector2D<int>{0, 16 * row}, line, fg_color_, bg_color_);
+	FillRectangle(*writer_, {8 * len, 16 * row}, {8 * (columns_ - len), 16}, bg_color_);
+}
+
+void Console::MarkRowDirty(int row) {
+	if (dirty_begin_ >= dirty_end_) {
+		dirty_begin_ = row;
+		dirty_end_ = row + 1;
+		return;
+	}
+	dirty_begin_ = std::min(dirty_begin_, row);
+	dirty_end_ = std::max(dirty_end_, row + 1);
+}
+
+void Console::ScrollDisplay(int rows) {
+	scroll_pending_ += rows;
+	if (dirty_begin_ < dirty_end_) {
+		dirty_begin_ = std::clamp(dirty_begin_ - rows, 0, rows_);
+		dirty_end_ = std::clamp(dirty_end_ - rows, 0, rows_);
+	}
+
+	if (rows > 0) {
+		MarkRowDirty(std::max(rows_ - rows, 0));
+		MarkRowDirty(rows_ - 1);
+	} else {
+		MarkRowDirty(0);
+		MarkRowDirty(std::min(-rows, rows_) - 1);
+	}
+}
+
+char* Console::Row(int row) {
+	return &buffer_[((row + row_offset_) % rows_) * (columns_ + 1)];
 }
 
 Console* console;
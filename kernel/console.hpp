@@ -4,12 +4,17 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include "graphics.hpp"
 #include "window.hpp"
+#include "scrollback.hpp"
 
 class Console {
 public:
-	static const int kRows = 25, kColumns = 80;
+	// ヒープが使えるようになってResize()するまでの行数と桁数
+	static constexpr int kDefaultRows = 25, kDefaultColumns = 80;
+	// 桁数の上限
+	static constexpr int kMaxColumns = 512;
 
 	Console(const PixelColor& fg_color, const PixelColor& bg_color);
 
@@ -20,9 +25,45 @@ public:
 	 * 
 	 * 与えられた文字列を先頭から1文字ずつ処理する
 	 * 改行文字ならNewline()に処理を移譲する
+	 * ウィンドウに出力している間は文字列を記録するだけで、描画は次のRender()まで遅らせる
 	 */
 	void PutString(const char* s);
 
+	/**
+	 * @brief 前回から書き換えられた行とスクロールをまとめてウィンドウに描画する
+	 *
+	 * メインループから1周に1回呼ぶ。画面への反映はLayerManager::Flushで行われる
+	 */
+	void Render();
+
+	/**
+	 * @brief Render()したうえで画面への反映まで同期的に済ませる
+	 *
+	 * 停止直前のエラーなど、メインループに戻らない可能性がある場合に使う
+	 */
+	void Flush();
+
+	/**
+	 * @brief 表示する範囲をlines行だけ過去の履歴の方へずらす。負の値なら新しい方へ戻す
+	 *
+	 * 画面から流れ出た行は履歴として保持しており、最新の画面から履歴の最古の行までの範囲で表示をずらせる
+	 * 表示はWindow::Scrollでずらし、新たに見えるようになった行だけを次のRender()で描く
+	 */
+	void ScrollView(int lines);
+
+	/**
+	 * @brief 行数と桁数を変更する。ヒープを使うので、メモリ管理を初期化してから呼ぶこと
+	 *
+	 * カーソル行から上の行を新しい桁数に収まらなければ続く行へ折り返し、新しい行数に収まるだけ引き継ぐ
+	 * 収まらない上の行は履歴に移す
+	 * ウィンドウに出力している場合は新しい大きさのウィンドウを作る。折り返した行がなければ引き継いだ行の描画済みの内容を複製し、
+	 * 新たに増えた領域だけを描く。折り返した場合は引き継いだ行をすべて描き直す。レイヤIDが設定されていればレイヤのウィンドウも差し替える
+	 */
+	void Resize(int rows, int columns);
+
+	int Rows() const;
+	int Columns() const;
+
 	void SetWriter(PixelWriter* writer);
 
 	void SetWindow(const std::shared_ptr<Window>& window);
@@ -37,17 +78,54 @@ private:
 	 * 
 	 * 現在のカーソル位置がまだ最下行に達していないなら単にカーソルを1行進めるだけ
 	 * 最下行にあるときはカーソルを進める代わりに表示領域全体を1行ずらすスクロール処理をする必要がある
-	 * 1秒ずつbuffer_の中身をずらしながら再描画する
+	 * buffer_の先頭行を履歴へ移し、空けた行を最下行とする
+	 * 表示はRender()でまとめてずらす。ウィンドウがあればWindow::Scroll、なければ全体の再描画で行う
 	 */
 	void Newline();
 
 	void Refresh();
 
+	/**
+	 * @brief 表示のrow行目に当たる行を背景色ごと描画する
+	 */
+	void DrawRow(int row);
+
+	/**
+	 * @brief 表示のrow行目を次のRender()で描き直す範囲に加える
+	 */
+	void MarkRowDirty(int row);
+
+	/**
+	 * @brief 表示の内容をrows行上へずらすことを記録する。負の値なら下へずらす
+	 *
+	 * ずらした結果新たに現れる行は描き直す範囲に加える
+	 */
+	void ScrollDisplay(int rows);
+
+	/**
+	 * @brief 画面上のrow行目の文字列を格納しているbuffer_の行を返す
+	 */
+	char* Row(int row);
+
 	PixelWriter* writer_;
 	std::shared_ptr<Window> window_;
 	const PixelColor fg_color_, bg_color_;
-	char buffer_[kRows][kColumns + 1];
+	int rows_, columns_;
+	// 行単位のリングバッファ。1行はcolumns_ + 1バイトで、画面上の0行目はbuffer_の第row_offset_行
+	// Resize()するまでは静的に確保したdefault_buffer_を、した後はbuffer_storage_を指す
+	char default_buffer_[kDefaultRows * (kDefaultColumns + 1)];
+	std::vector<char> buffer_storage_;
+	char* buffer_;
+	int row_offset_;
 	int cursor_row_, cursor_column_;
+	// 次のRender()で描き直す行の範囲[dirty_begin_, dirty_end_)と、まだ表示に反映していないスクロール行数
+	int dirty_begin_, dirty_end_;
+	int scroll_pending_;
+	// 画面から流れ出た行の履歴
+	Scrollback history_;
+	// 表示を最新の画面から何行過去へずらしているか。表示のrow行目には画面のrow - view_offset_行目が見える
+	// 負になる行は履歴の末尾から数えた行
+	int view_offset_;
 	unsigned int layer_id_;
 };
 
@@ -4,6 +4,8 @@
  */
 #include "font.hpp"
 
+#include "blit.hpp"
+
 /**
  * objcopyで生成されたシンボル（hankaku.bin → hankaku.o）
  *
@@ -52,22 +54,155 @@ const uint8_t* GetFont(char c) {
     return &_binary_hankaku_bin_start + index;
 }
 
+namespace {
+    const int kGlyphWidth = 8;
+    const int kGlyphHeight = 16;
+
+    /**
+     * @brief フォントの1行分(8ビット)の全256通りを、前景色と背景色の8ピクセルに展開した表
+     *
+     * ピクセル値は書き込み先の形式に変換済みなので、キーもその値で持つ。
+     * 同じ値になる組み合わせは同じ見た目になるので、書き込み先の形式が違っても共有してよい。
+     */
+    struct RowTable {
+        bool valid;
+        uint32_t fg, bg;
+        uint32_t rows[256][kGlyphWidth];
+    };
+
+    // 使う色の組は少ないので、少数の表を順番に使い回す
+    const size_t kRowTableCount = 4;
+    RowTable row_tables[kRowTableCount];
+    size_t next_row_table = 0;
+
+    /**
+     * @brief 色の組に対応する展開表を返す。なければ最も古い表を作り直す
+     */
+    const RowTable& GetRowTable(uint32_t fg, uint32_t bg) {
+        for (const auto& table : row_tables) {
+            if (table.valid && table.fg == fg && table.bg == bg) {
+                return table;
+            }
+        }
+
+        RowTable& table = row_tables[next_row_table];
+        next_row_table = (next_row_table + 1) % kRowTableCount;
+        for (unsigned int bits = 0; bits < 256; ++bits) {
+            for (int dx = 0; dx < kGlyphWidth; ++dx) {
+                table.rows[bits][dx] = ((bits << dx) & 0x80u) ? fg : bg;
+            }
+        }
+        table.valid = true;
+        table.fg = fg;
+        table.bg = bg;
+        return table;
+    }
+
+    // フォントがない文字は空白として描く
+    const uint8_t kBlankFont[kGlyphHeight] = {};
+
+    /**
+     * @brief 前景色と背景色で展開済みの1文字分のピクセル
+     *
+     * キーは展開表と同じく書き込み先の形式に変換済みのピクセル値で持つ。
+     */
+    struct Glyph {
+        bool valid;
+        uint8_t code;
+        uint32_t fg, bg;
+        uint32_t pixels[kGlyphHeight][kGlyphWidth];
+    };
+
+    // ダイレクトマップ方式のグリフキャッシュ
+    const size_t kGlyphCacheSize = 128;
+    Glyph glyph_cache[kGlyphCacheSize];
+
+    /**
+     * @brief 文字と色の組に対応する展開済みグリフを返す。フォントがない文字は空白のグリフになる
+     *
+     * キャッシュになければ、色の組の展開表から16行を引いて作る
+     * 戻り値は次にこの関数を呼ぶと別の文字で上書きされることがある
+     */
+    const Glyph& GetGlyph(char c, uint32_t fg, uint32_t bg) {
+        const auto code = static_cast<uint8_t>(c);
+        const uint32_t hash = code * 0x9e3779b1u ^ fg * 0x85ebca6bu ^ bg * 0xc2b2ae35u;
+        Glyph& glyph = glyph_cache[(hash >> 16) % kGlyphCacheSize];
+        if (glyph.valid && glyph.code == code && glyph.fg == fg && glyph.bg == bg) {
+            return glyph;
+        }
+
+        const RowTable& table = GetRowTable(fg, bg);
+        const uint8_t* font = GetFont(c);
+        if (font == nullptr) {
+            font = kBlankFont;
+        }
+        for (int dy = 0; dy < kGlyphHeight; ++dy) {
+            CopyPixels32(glyph.pixels[dy], table.rows[font[dy]], kGlyphWidth);
+        }
+        glyph.valid = true;
+        glyph.code = code;
+        glyph.fg = fg;
+        glyph.bg = bg;
+        return glyph;
+    }
+}
+
 void WriteAscii(PixelWriter &writer, Vector2D<int> pos, char c, const PixelColor& color) {
     const uint8_t* font = GetFont(c);
     if (font == nullptr) {
         return;
     }
-	  for (int dy = 0; dy < 16; ++dy) {
-		    for (int dx = 0; dx < 8; ++dx) {
-			      if ((font[dy] << dx) & 0x80u) {
-				        writer.Write(pos + Vector2D<int>{dx, dy}, color);
-			      }
-		    }
-	  }
+    for (int dy = 0; dy < kGlyphHeight; ++dy) {
+        const unsigned int bits = font[dy];
+        int dx = 0;
+        while (dx < kGlyphWidth) {
+            if (((bits << dx) & 0x80u) == 0) {
+                ++dx;
+                continue;
+            }
+            const int begin = dx;
+            while (dx < kGlyphWidth && ((bits << dx) & 0x80u)) {
+                ++dx;
+            }
+            writer.FillSpan(pos.y + dy, pos.x + begin, pos.x + dx, color);
+        }
+    }
 }
 
 void WriteString(PixelWriter& writer, Vector2D<int> pos, const char* s, const PixelColor& color) {
     for (int i = 0; s[i] != '\0'; ++i) {
       WriteAscii(writer, pos + Vector2D<int>{8 * i, 0}, s[i], color);
     }
-}
\ No newline at end of file
+}
+
+void WriteAscii(PixelWriter& writer, Vector2D<int> pos, char c,
+                const PixelColor& fg, const PixelColor& bg) {
+    const char s[2] = {c, '\0'};
+    WriteString(writer, pos, s, fg, bg);
+}
+
+void WriteString(PixelWriter& writer, Vector2D<int> pos, const char* s,
+                 const PixelColor& fg, const PixelColor& bg) {
+    const uint32_t fg_pixel = writer.Encode(fg);
+    const uint32_t bg_pixel = writer.Encode(bg);
+
+    // 数十文字ずつ、各文字の展開済みグリフの同じ行を横に並べて1行分のピクセル列を作り、まとめて書き込む
+    // グリフキャッシュの内容は他の文字で上書きされうるので、並べる文字のグリフは先に複製しておく
+    const int kChunkChars = 16;
+    uint32_t band[kGlyphHeight][kChunkChars * kGlyphWidth];
+    while (*s != '\0') {
+        int n = 0;
+        for (; n < kChunkChars && s[n] != '\0'; ++n) {
+            const Glyph& glyph = GetGlyph(s[n], fg_pixel, bg_pixel);
+            for (int dy = 0; dy < kGlyphHeight; ++dy) {
+                CopyPixels32(&band[dy][n * kGlyphWidth], glyph.pixels[dy], kGlyphWidth);
+            }
+        }
+
+        for (int dy = 0; dy < kGlyphHeight; ++dy) {
+            writer.WriteRow(pos + Vector2D<int>{0, dy}, band[dy], n * kGlyphWidth);
+        }
+        pos.x += n * kGlyphWidth;
+        s += n;
+    }
+}
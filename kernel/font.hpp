@@ -18,9 +18,18 @@
  * GetFont()で取得したフォントデータ（16バイト）を解釈し、
  * ビットが立っているピクセルを指定色で描画する。
  * フォントは 8x16 ピクセルのビットマップ形式。
+ * 横に連続するピクセルはFillSpanでまとめて描画する。
  */
 void WriteAscii(PixelWriter& writer, Vector2D<int> pos, char c, const PixelColor& color);
 
+/**
+ * @brief 1文字を前景色と背景色で描画する
+ *
+ * 文字の 8x16 ピクセルをすべて書き換える。詳細は前景色と背景色を取るWriteString()を参照。
+ */
+void WriteAscii(PixelWriter& writer, Vector2D<int> pos, char c,
+                const PixelColor& fg, const PixelColor& bg);
+
 /**
  * @brief 文字列を描画する
  *
@@ -32,4 +41,22 @@ void WriteAscii(PixelWriter& writer, Vector2D<int> pos, char c, const PixelColor
  * 文字列の各文字をWriteAscii()で順番に描画する。
  * 各文字は横8ピクセルずつ右にずらして配置される。
  */
-void WriteString(PixelWriter& writer, Vector2D<int> pos, const char* s, const PixelColor& color);
\ No newline at end of file
+void WriteString(PixelWriter& writer, Vector2D<int> pos, const char* s, const PixelColor& color);
+
+/**
+ * @brief 文字列を前景色と背景色で描画する
+ *
+ * @param writer ピクセル描画を行うPixelWriterオブジェクト
+ * @param pos 描画開始座標
+ * @param s 描画する文字列（NULL終端）
+ * @param fg 文字の色
+ * @param bg 文字の背景の色
+ *
+ * 各文字の 8x16 ピクセルをすべて書き換える。
+ * 背景を塗りつぶしてから文字を重ねる場合と違い、各ピクセルを1度だけ書く。
+ * 文字と色の組ごとに展開済みのグリフをキャッシュしておき、数十文字分のグリフを横に並べて
+ * PixelWriter::WriteRow()で行ごとにまとめて書き込む。
+ * キャッシュにないグリフは、色の組ごとにフォント1行分(8ビット)の全256通りを展開した表から作る。
+ */
+void WriteString(PixelWriter& writer, Vector2D<int> pos, const char* s,
+                 const PixelColor& fg, const PixelColor& bg);
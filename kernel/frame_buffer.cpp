@@ -3,6 +3,9 @@
  */
 #include "frame_buffer.hpp"
 
+#include <cstring>
+#include "blit.hpp"
+
 namespace {
 	/**
 	 * @brief 1ピクセルのバイト数を返す
@@ -20,6 +23,10 @@ namespace {
 			(config.pixels_per_scan_line * pos.y + pos.x);
 	}
 
+	uint32_t* PixelAddrAt(Vector2D<int> pos, const FrameBufferConfig& config) {
+		return reinterpret_cast<uint32_t*>(FrameAddrAt(pos, config));
+	}
+
 	int BytesPerScanLine(const FrameBufferConfig& config) {
 		return BytesPerPixel(config.pixel_format) * config.pixels_per_scan_line;
 	}
@@ -71,7 +78,7 @@ Error FrameBuffer::Copy(Vector2D<int> dst_pos, const FrameBuffer& src, const Rec
 	}
 
 	const auto bytes_per_pixel = BytesPerPixel(config_.pixel_format);
-	if (bytes_per_pixel <= 0) {
+	if (bytes_per_pixel != 4) {
 		return MAKE_ERROR(Error::kUnknownPixelFormat);
 	}
 
@@ -81,13 +88,26 @@ Error FrameBuffer::Copy(Vector2D<int> dst_pos, const FrameBuffer& src, const Rec
 	const auto copy_area = dst_outline & src_outline & src_area_shifted;
 	const auto src_start_pos = copy_area.pos - (dst_pos - src_area.pos);
 
-	uint8_t* dst_buf = FrameAddrAt(copy_area.pos, config_);
-	const uint8_t* src_buf = FrameAddrAt(src_start_pos, src.config_);
+	if (IsEmpty(copy_area)) {
+		return MAKE_ERROR(Error::kSuccess);
+	}
+
+	uint32_t* dst_buf = PixelAddrAt(copy_area.pos, config_);
+	const uint32_t* src_buf = PixelAddrAt(src_start_pos, src.config_);
 
+	// 自身がVRAMを指している場合は、書き込んだ内容を読み返すことはないのでキャッシュを汚さずに書き込む
+	const bool to_vram = IsVRAM();
 	for (int y = 0; y < copy_area.size.y; ++y) {
-		memcpy(dst_buf, src_buf, bytes_per_pixel * copy_area.size.x);
-		dst_buf += BytesPerScanLine(config_);
-		src_buf += BytesPerScanLine(src.config_);
+		if (to_vram) {
+			StreamPixels32(dst_buf, src_buf, copy_area.size.x);
+		} else {
+			CopyPixels32(dst_buf, src_buf, copy_area.size.x);
+		}
+		dst_buf += config_.pixels_per_scan_line;
+		src_buf += src.config_.pixels_per_scan_line;
+	}
+	if (to_vram) {
+		StoreFence();
 	}
 
 	return MAKE_ERROR(Error::kSuccess);
@@ -95,23 +115,40 @@ Error FrameBuffer::Copy(Vector2D<int> dst_pos, const FrameBuffer& src, const Rec
 
 void FrameBuffer::Move(Vector2D<int> dst_pos, const Rectangle<int>& src) {
 	const auto bytes_per_pixel = BytesPerPixel(config_.pixel_format);
-	const auto bytes_per_scan_line = BytesPerScanLine(config_);
+	const auto pixels_per_scan_line = static_cast<int>(config_.pixels_per_scan_line);
 
-	if (dst_pos.y < src.pos.y) {
+	if (dst_pos.y == src.pos.y) {
+		// 同じ行の中で左右に動かす場合はコピー元とコピー先が重なりうる
 		uint8_t* dst_buf = FrameAddrAt(dst_pos, config_);
 		const uint8_t* src_buf = FrameAddrAt(src.pos, config_);
 		for (int y = 0; y < src.size.y; ++y) {
-			memcpy(dst_buf, src_buf, bytes_per_pixel * src.size.x);
-			dst_buf += bytes_per_scan_line;
-			src_buf += bytes_per_scan_line;
+			memmove(dst_buf, src_buf, bytes_per_pixel * src.size.x);
+			dst_buf += BytesPerScanLine(config_);
+			src_buf += BytesPerScanLine(config_);
+		}
+		return;
+	}
+
+	// 行が異なれば1行の中でコピー元とコピー先が重なることはない
+	auto copy_line = IsVRAM() ? StreamPixels32 : CopyPixels32;
+	if (dst_pos.y < src.pos.y) {
+		uint32_t* dst_buf = PixelAddrAt(dst_pos, config_);
+		const uint32_t* src_buf = PixelAddrAt(src.pos, config_);
+		for (int y = 0; y < src.size.y; ++y) {
+			copy_line(dst_buf, src_buf, src.size.x);
+			dst_buf += pixels_per_scan_line;
+			src_buf += pixels_per_scan_line;
 		}
 	} else {
-		uint8_t* dst_buf = FrameAddrAt(dst_pos + Vector2D<int>{0, src.size.y - 1}, config_);
-		const uint8_t* src_buf = FrameAddrAt(src.pos + Vector2D<int>{0, src.size.y - 1}, config_);
+		uint32_t* dst_buf = PixelAddrAt(dst_pos + Vector2D<int>{0, src.size.y - 1}, config_);
+		const uint32_t* src_buf = PixelAddrAt(src.pos + Vector2D<int>{0, src.size.y - 1}, config_);
 		for (int y = 0; y < src.size.y; ++y) {
-			memcpy(dst_buf, src_buf, bytes_per_pixel * src.size.x);
-			dst_buf -= bytes_per_scan_line;
-			src_buf -= bytes_per_scan_line;
+			copy_line(dst_buf, src_buf, src.size.x);
+			dst_buf -= pixels_per_scan_line;
+			src_buf -= pixels_per_scan_line;
 		}
 	}
+	if (IsVRAM()) {
+		StoreFence();
+	}
 }
\ No newline at end of file
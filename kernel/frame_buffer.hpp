@@ -31,6 +31,23 @@ public:
 
 	const FrameBufferConfig& Config() const { return config_; }
 
+	/**
+	 * @brief 指定した位置のピクセルを指すポインタを返す。範囲の検査はしない
+	 */
+	uint32_t* PixelAddr(Vector2D<int> pos) {
+		return reinterpret_cast<uint32_t*>(config_.frame_buffer) +
+			config_.pixels_per_scan_line * pos.y + pos.x;
+	}
+	const uint32_t* PixelAddr(Vector2D<int> pos) const {
+		return reinterpret_cast<const uint32_t*>(config_.frame_buffer) +
+			config_.pixels_per_scan_line * pos.y + pos.x;
+	}
+
+	/**
+	 * @brief 自前のバッファではなく、外部から与えられたVRAMを描画領域としているならtrueを返す
+	 */
+	bool IsVRAM() const { return buffer_.empty(); }
+
 private:
 	// 描画領域に関する構成情報
 	FrameBufferConfig config_{};
@@ -3,6 +3,58 @@
  */
 #include "graphics.hpp"
 
+#include "blit.hpp"
+
+void PixelWriter::FillSpan(int y, int x0, int x1, const PixelColor& c) {
+	for (int x = x0; x < x1; ++x) {
+		Write({x, y}, c);
+	}
+}
+
+void PixelWriter::FillRect(Vector2D<int> pos, Vector2D<int> size, const PixelColor& c) {
+	for (int dy = 0; dy < size.y; ++dy) {
+		FillSpan(pos.y + dy, pos.x, pos.x + size.x, c);
+	}
+}
+
+uint32_t PixelWriter::Encode(const PixelColor& c) const {
+	return EncodePixel(kPixelBGRResv8BitPerColor, c);
+}
+
+void PixelWriter::WriteRow(Vector2D<int> pos, const uint32_t* pixels, int n) {
+	for (int i = 0; i < n; ++i) {
+		Write(pos + Vector2D<int>{i, 0}, DecodePixel(kPixelBGRResv8BitPerColor, pixels[i]));
+	}
+}
+
+void FrameBufferWriter::FillSpan(int y, int x0, int x1, const PixelColor& c) {
+	FillRect({x0, y}, {x1 - x0, 1}, c);
+}
+
+void FrameBufferWriter::FillRect(Vector2D<int> pos, Vector2D<int> size, const PixelColor& c) {
+	if (size.x <= 0 || size.y <= 0) {
+		return;
+	}
+
+	const uint32_t value = EncodePixel(config_.pixel_format, c);
+	auto row = reinterpret_cast<uint32_t*>(PixelAt(pos));
+	for (int dy = 0; dy < size.y; ++dy) {
+		FillPixels32(row, value, size.x);
+		row += config_.pixels_per_scan_line;
+	}
+}
+
+uint32_t FrameBufferWriter::Encode(const PixelColor& c) const {
+	return EncodePixel(config_.pixel_format, c);
+}
+
+void FrameBufferWriter::WriteRow(Vector2D<int> pos, const uint32_t* pixels, int n) {
+	if (n <= 0) {
+		return;
+	}
+	CopyPixels32(reinterpret_cast<uint32_t*>(PixelAt(pos)), pixels, n);
+}
+
 void RGBResv8BitPerColorPixelWriter::Write(Vector2D<int> pos, const PixelColor& c) {
 	auto p = PixelAt(pos);
 	p[0] = c.r;
@@ -19,24 +71,16 @@ void BGRResv8BitPerColorPixelWriter::Write(Vector2D<int> pos, const PixelColor&
 
 void DrawRectangle(PixelWriter& writer, const Vector2D<int>& pos,
 				   const Vector2D<int>& size, const PixelColor& c) {
-	for (int dx = 0; dx < size.x; ++dx) {
-		writer.Write(pos + Vector2D<int>{dx, 0}, c);
-		writer.Write(pos + Vector2D<int>{dx, size.y - 1}, c);
-	}
-	for (int dy = 1; dy < size.y - 1; ++dy) {
-		writer.Write(pos + Vector2D<int>{0, dy}, c);
-		writer.Write(pos + Vector2D<int>{size.x - 1, dy}, c);
-	}
+	writer.FillSpan(pos.y, pos.x, pos.x + size.x, c);
+	writer.FillSpan(pos.y + size.y - 1, pos.x, pos.x + size.x, c);
+	writer.FillRect(pos + Vector2D<int>{0, 1}, {1, size.y - 2}, c);
+	writer.FillRect(pos + Vector2D<int>{size.x - 1, 1}, {1, size.y - 2}, c);
 }
 
 
 void FillRectangle(PixelWriter& writer, const Vector2D<int>& pos,
 				   const Vector2D<int>& size, const PixelColor& c) {
-	for (int dy = 0; dy < size.y; ++dy) {
-		for (int dx = 0; dx < size.x; ++dx) {
-			writer.Write(pos + Vector2D<int>{dx, dy}, c);
-		}
-	}
+	writer.FillRect(pos, size, c);
 }
 
 void DrawDesktop(PixelWriter& writer) {
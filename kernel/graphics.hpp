@@ -10,9 +10,11 @@
  * @brief ピクセルの色を設定する構造体
  *
  * RGB各成分を8ビット（0〜255）で表現する
+ * aは不透明度で、アルファ合成が有効なウィンドウでのみ使われる。省略すると不透明(255)となる
  */
 struct PixelColor {
 	uint8_t r, g, b;	// [R 8bit][G 8bit][B 8bit]
+	uint8_t a = 255;
 };
 
 inline bool operator==(const PixelColor& lhs, const PixelColor& rhs) {
@@ -23,6 +25,37 @@ inline bool operator!=(const PixelColor& lhs, const PixelColor& rhs) {
 	return !(lhs == rhs);
 }
 
+/**
+ * @brief 色を指定したデータ形式の32ビットピクセル値に変換する。予約領域は0とする
+ */
+inline uint32_t EncodePixel(PixelFormat format, const PixelColor& c) {
+	if (format == kPixelRGBResv8BitPerColor) {
+		return c.r | (c.g << 8) | (c.b << 16);
+	}
+	return c.b | (c.g << 8) | (c.r << 16);
+}
+
+/**
+ * @brief 色をアルファ値乗算済み(premultiplied)のピクセル値に変換する。予約領域にアルファ値を格納する
+ */
+inline uint32_t EncodePremultipliedPixel(PixelFormat format, const PixelColor& c) {
+	auto mul = [a = c.a](uint8_t x) { return static_cast<uint8_t>((x * a + 127) / 255); };
+	return EncodePixel(format, {mul(c.r), mul(c.g), mul(c.b)}) | (static_cast<uint32_t>(c.a) << 24);
+}
+
+/**
+ * @brief 指定したデータ形式の32ビットピクセル値を色に変換する
+ */
+inline PixelColor DecodePixel(PixelFormat format, uint32_t pixel) {
+	const auto lo = static_cast<uint8_t>(pixel & 0xff);
+	const auto mid = static_cast<uint8_t>((pixel >> 8) & 0xff);
+	const auto hi = static_cast<uint8_t>((pixel >> 16) & 0xff);
+	if (format == kPixelRGBResv8BitPerColor) {
+		return {lo, mid, hi};
+	}
+	return {hi, mid, lo};
+}
+
 /**
  * @brief いろいろな型で、2次元ベクトルを表現する構造体
  */
@@ -84,7 +117,7 @@ Rectangle<T> operator&(const Rectangle<T>& lhs, const Rectangle<U>& rhs) {
 	const auto lhs_end = lhs.pos + lhs.size;
 	const auto rhs_end = rhs.pos + rhs.size;
 	if (lhs_end.x < rhs.pos.x || lhs_end.y < rhs.pos.y ||
-			rhs_end.x < lhs.pos.x || rhs_end.x < lhs.pos.y) {
+			rhs_end.x < lhs.pos.x || rhs_end.y < lhs.pos.y) {
 		return {{0, 0}, {0, 0}};
 	}
 
@@ -93,6 +126,31 @@ Rectangle<T> operator&(const Rectangle<T>& lhs, const Rectangle<U>& rhs) {
 	return {new_pos, new_size};
 }
 
+/**
+ * @brief 面積が0の矩形ならtrueを返す
+ */
+template <typename T>
+bool IsEmpty(const Rectangle<T>& rect) {
+	return rect.size.x <= 0 || rect.size.y <= 0;
+}
+
+/**
+ * @brief 2つの矩形を両方とも含む最小の矩形を返す。空の矩形は無視する
+ */
+template <typename T>
+Rectangle<T> operator|(const Rectangle<T>& lhs, const Rectangle<T>& rhs) {
+	if (IsEmpty(lhs)) {
+		return rhs;
+	}
+	if (IsEmpty(rhs)) {
+		return lhs;
+	}
+
+	auto new_pos = ElementMin(lhs.pos, rhs.pos);
+	auto new_end = ElementMax(lhs.pos + lhs.size, rhs.pos + rhs.size);
+	return {new_pos, new_end - new_pos};
+}
+
 /**
  * @brief ピクセル描画を行う抽象基底クラス
  *
@@ -119,6 +177,34 @@ public:
 	 */
 	virtual void Write(Vector2D<int> pos, const PixelColor& c) = 0;
 
+	/**
+	 * @brief y行目のx0からx1の手前までを塗りつぶす
+	 *
+	 * 既定の実装は1ピクセルずつWriteを呼ぶ。派生クラスでより速い実装に置き換えられる
+	 */
+	virtual void FillSpan(int y, int x0, int x1, const PixelColor& c);
+
+	/**
+	 * @brief 左上がpos、大きさがsizeの長方形を塗りつぶす
+	 *
+	 * 既定の実装は1行ずつFillSpanを呼ぶ
+	 */
+	virtual void FillRect(Vector2D<int> pos, Vector2D<int> size, const PixelColor& c);
+
+	/**
+	 * @brief 色をこのPixelWriterの書き込み先と同じ形式の32ビットピクセル値に変換する
+	 *
+	 * 既定の実装はBGR形式で変換する。WriteRowに渡すピクセル列はこの関数で作ること
+	 */
+	virtual uint32_t Encode(const PixelColor& c) const;
+
+	/**
+	 * @brief posから右へn個のピクセルを書き込む。pixelsの各値はEncodeで変換済みとする
+	 *
+	 * 既定の実装は1ピクセルずつ色に戻してWriteを呼ぶ
+	 */
+	virtual void WriteRow(Vector2D<int> pos, const uint32_t* pixels, int n);
+
 	virtual int Width() const = 0;
 	virtual int Height() const = 0;
 };
@@ -131,6 +217,18 @@ public:
 	virtual int Width() const override { return config_.horizontal_resolution; }
 	virtual int Height() const override { return config_.vertical_resolution; }
 
+	/**
+	 * @brief 色を1度だけピクセル値に変換し、SIMD命令で行単位に書き込む
+	 */
+	virtual void FillSpan(int y, int x0, int x1, const PixelColor& c) override;
+	virtual void FillRect(Vector2D<int> pos, Vector2D<int> size, const PixelColor& c) override;
+
+	/**
+	 * @brief ピクセル値はフレームバッファの形式そのままなので、行単位でまとめてコピーする
+	 */
+	virtual uint32_t Encode(const PixelColor& c) const override;
+	virtual void WriteRow(Vector2D<int> pos, const uint32_t* pixels, int n) override;
+
 protected:
 	/**
 	 * @brief 指定座標のピクセルのメモリアドレスを取得する
@@ -0,0 +1,26 @@
+/**
+ * @file keyboard.cpp
+ */
+#include "keyboard.hpp"
+
+#include <algorithm>
+#include "console.hpp"
+#include "usb/classdriver/keyboard.hpp"
+
+namespace {
+	// HIDのキーボードの使用ID
+	const uint8_t kKeyPageUp = 0x4b;
+	const uint8_t kKeyPageDown = 0x4e;
+}
+
+void InitializeKeyboard() {
+	// オブザーバはメインループのusb::xhci::ProcessEventsから呼ばれるので、コンソールを直接操作してよい
+	usb::HIDKeyboardDriver::default_observer = [](uint8_t keycode) {
+		const int lines = std::max(console->Rows() / 2, 1);
+		if (keycode == kKeyPageUp) {
+			console->ScrollView(lines);
+		} else if (keycode == kKeyPageDown) {
+			console->ScrollView(-lines);
+		}
+	};
+}
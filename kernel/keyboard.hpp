@@ -0,0 +1,11 @@
+/**
+ * @file keyboard.hpp
+ */
+#pragma once
+
+/**
+ * @brief USBキーボードのキー入力を受け取る処理を登録する
+ *
+ * PageUpとPageDownでコンソールの表示を履歴の方へ半画面ずつずらす
+ */
+void InitializeKeyboard();
@@ -4,9 +4,84 @@
 #include "layer.hpp"
 
 #include <algorithm>
+#include <limits>
 #include "console.hpp"
 #include "logger.hpp"
 
+namespace {
+	// 再描画領域として保持する矩形の最大数
+	const size_t kMaxDamageRects = 16;
+
+	/**
+	 * @brief rectからholeを取り除いた残りを、最大4つの矩形に分けてoutへ追加する
+	 */
+	void SubtractRectangle(const Rectangle<int>& rect, const Rectangle<int>& hole,
+						   std::vector<Rectangle<int>>& out) {
+		const auto overlap = rect & hole;
+		if (IsEmpty(overlap)) {
+			out.push_back(rect);
+			return;
+		}
+
+		const auto rect_end = rect.pos + rect.size;
+		const auto overlap_end = overlap.pos + overlap.size;
+		// 上側と下側は矩形の幅いっぱいに、左側と右側は重なり部分の高さだけ取る
+		if (rect.pos.y < overlap.pos.y) {
+			out.push_back({rect.pos, {rect.size.x, overlap.pos.y - rect.pos.y}});
+		}
+		if (overlap_end.y < rect_end.y) {
+			out.push_back({{rect.pos.x, overlap_end.y}, {rect.size.x, rect_end.y - overlap_end.y}});
+		}
+		if (rect.pos.x < overlap.pos.x) {
+			out.push_back({{rect.pos.x, overlap.pos.y}, {overlap.pos.x - rect.pos.x, overlap.size.y}});
+		}
+		if (overlap_end.x < rect_end.x) {
+			out.push_back({{overlap_end.x, overlap.pos.y}, {rect_end.x - overlap_end.x, overlap.size.y}});
+		}
+	}
+
+	/**
+	 * @brief 互いに重ならない矩形の集合rectsにareaを加える
+	 *
+	 * areaと重なる矩形は取り除いて1つの矩形に統合することを、重なりがなくなるまで繰り返す
+	 * 矩形の数はkMaxDamageRects以下に抑える
+	 */
+	void AddRectangle(std::vector<Rectangle<int>>& rects, Rectangle<int> area) {
+		for (size_t i = 0; i < rects.size();) {
+			if (IsEmpty(rects[i] & area)) {
+				++i;
+				continue;
+			}
+			area = area | rects[i];
+			rects[i] = rects.back();
+			rects.pop_back();
+			i = 0;
+		}
+
+		if (rects.size() < kMaxDamageRects) {
+			rects.push_back(area);
+			return;
+		}
+
+		// 矩形が多すぎるときは、統合による面積の増加が最も小さい矩形とまとめる
+		size_t best = 0;
+		long best_growth = std::numeric_limits<long>::max();
+		for (size_t i = 0; i < rects.size(); ++i) {
+			const auto merged = rects[i] | area;
+			const long growth = static_cast<long>(merged.size.x) * merged.size.y
+				- static_cast<long>(rects[i].size.x) * rects[i].size.y;
+			if (growth < best_growth) {
+				best = i;
+				best_growth = growth;
+			}
+		}
+		area = area | rects[best];
+		rects[best] = rects.back();
+		rects.pop_back();
+		AddRectangle(rects, area);
+	}
+}
+
 Layer::Layer(unsigned int id) : id_{id} {
 }
 
@@ -36,6 +111,15 @@ bool Layer::IsDraggable() const {
 	return draggable_;
 }
 
+Layer& Layer::SetOpacity(uint8_t opacity) {
+	opacity_ = opacity;
+	return *this;
+}
+
+uint8_t Layer::Opacity() const {
+	return opacity_;
+}
+
 Layer& Layer::Move(Vector2D<int> pos) {
 	pos_ = pos;
 	return *this;
@@ -48,71 +132,300 @@ Layer& Layer::MoveRelative(Vector2D<int> pos_diff) {
 
 void Layer::DrawTo(FrameBuffer& screen, const Rectangle<int>& area) const {
 	if (window_) {
-		window_->DrawTo(screen, pos_, area);
+		window_->DrawTo(screen, pos_, area, opacity_);
 	}
 }
 
+int Layer::Height() const {
+	return height_;
+}
+
+bool Layer::IsOpaque() const {
+	return window_ && window_->IsOpaque() && opacity_ == 255;
+}
+
+bool Layer::IsBlended() const {
+	return window_ && (window_->AlphaBlending() || opacity_ < 255);
+}
+
 void LayerManager::SetWriter(FrameBuffer* screen) {
 	screen_ = screen;
 
 	FrameBufferConfig back_config = screen->Config();
 	back_config.frame_buffer = nullptr;
 	back_buffer_.Initialize(back_config);
+
+	const Vector2D<int> screen_size{
+		static_cast<int>(back_config.horizontal_resolution),
+		static_cast<int>(back_config.vertical_resolution)};
+	tile_count_ = {(screen_size.x + kTileSize - 1) / kTileSize,
+				   (screen_size.y + kTileSize - 1) / kTileSize};
+	tiles_.clear();
+	tiles_.resize(tile_count_.x * tile_count_.y);
+	for (auto layer : layer_stack_) {
+		InsertIntoTiles(layer);
+	}
 }
 
 Layer& LayerManager::NewLayer() {
-	++latest_id_;
-	return *layers_.emplace_back(new Layer{latest_id_});
+	size_t slot;
+	if (free_slots_.empty()) {
+		// スロット番号+1がIDの下位kSlotBitsビットに収まらないと、世代番号のビットと重なってIDが区別できなくなる
+		if (layers_.size() >= kMaxLayers) {
+			Log(kError, "too many layers: %lu\n", static_cast<unsigned long>(layers_.size()));
+			exit(1);
+		}
+		slot = layers_.size();
+		layers_.push_back({nullptr, 0});
+	} else {
+		slot = free_slots_.back();
+		free_slots_.pop_back();
+		++layers_[slot].generation;
+	}
+
+	const unsigned int id = (layers_[slot].generation << kSlotBits) | (slot + 1);
+	layers_[slot].layer = std::make_unique<Layer>(id);
+	return *layers_[slot].layer;
+}
+
+void LayerManager::RemoveLayer(unsigned int id) {
+	auto layer = FindLayer(id);
+	if (!layer) {
+		return;
+	}
+	Hide(id);
+	const size_t slot = (id & ((1u << kSlotBits) - 1)) - 1;
+	layers_[slot].layer.reset();
+	free_slots_.push_back(slot);
 }
 
 void LayerManager::Draw(const Rectangle<int>& area) const {
-	for (auto layer : layer_stack_) {
-		layer->DrawTo(back_buffer_, area);
+	if (tiled_) {
+		const auto range = TileRange(area);
+		for (int ty = range.pos.y; ty < range.pos.y + range.size.y; ++ty) {
+			for (int tx = range.pos.x; tx < range.pos.x + range.size.x; ++tx) {
+				const auto& tile = tiles_[ty * tile_count_.x + tx];
+				const Rectangle<int> tile_area{{tx * kTileSize, ty * kTileSize}, {kTileSize, kTileSize}};
+				DrawLayers(tile.begin(), tile.end(), area & tile_area);
+			}
+		}
+	} else {
+		DrawLayers(layer_stack_.begin(), layer_stack_.end(), area);
 	}
-	screen_->Copy(area.pos, back_buffer_, area);
+	QueuePresent(area);
 }
 
 void LayerManager::Draw(unsigned int id) const {
-	bool draw = false;
-	Rectangle<int> window_area;
+	auto layer = FindLayer(id);
+	if (!layer || layer->height_ < 0) {
+		return;
+	}
+	auto it = layer_stack_.begin() + layer->height_;
+	const auto window_area = LayerArea(**it);
+	if (layer->IsBlended()) {
+		// back_buffer_には前回描いたこのレイヤが合成済みなので、その上に重ねず最下層から描き直す
+		Draw(window_area);
+		return;
+	}
+
+	// 指定したレイヤより下はback_buffer_に描画済みなので、指定したレイヤから上だけを描画する
+	if (tiled_) {
+		const auto range = TileRange(window_area);
+		for (int ty = range.pos.y; ty < range.pos.y + range.size.y; ++ty) {
+			for (int tx = range.pos.x; tx < range.pos.x + range.size.x; ++tx) {
+				const auto& tile = tiles_[ty * tile_count_.x + tx];
+				const Rectangle<int> tile_area{{tx * kTileSize, ty * kTileSize}, {kTileSize, kTileSize}};
+				auto tile_it = std::find(tile.begin(), tile.end(), layer);
+				DrawLayers(tile_it, tile.end(), window_area & tile_area);
+			}
+		}
+	} else {
+		DrawLayers(it, layer_stack_.end(), window_area);
+	}
+	QueuePresent(window_area);
+}
+
+void LayerManager::DrawLayers(std::vector<Layer*>::const_iterator first,
+							  std::vector<Layer*>::const_iterator last,
+							  const Rectangle<int>& area) const {
+	uncovered_.clear();
+	uncovered_.push_back(area);
+	draw_list_.clear();
+
+	// 上のレイヤから順に、まだ覆われていない部分のうちレイヤと重なる部分を描画対象として集める
+	for (auto it = last; it != first && !uncovered_.empty();) {
+		--it;
+		Layer* layer = *it;
+		const auto layer_area = LayerArea(*layer);
+		for (const auto& rect : uncovered_) {
+			const auto visible = rect & layer_area;
+			if (!IsEmpty(visible)) {
+				draw_list_.push_back({layer, visible});
+			}
+		}
+
+		if (layer->IsOpaque()) {
+			uncovered_next_.clear();
+			for (const auto& rect : uncovered_) {
+				SubtractRectangle(rect, layer_area, uncovered_next_);
+			}
+			uncovered_.swap(uncovered_next_);
+		}
+	}
+
+	// 透過するレイヤが下のレイヤに重なって描画されるよう、集めた順とは逆に下から描画する
+	for (auto it = draw_list_.rbegin(); it != draw_list_.rend(); ++it) {
+		it->first->DrawTo(back_buffer_, it->second);
+	}
+}
+
+void LayerManager::AddDamage(const Rectangle<int>& area) {
+	const auto new_area = area & ScreenArea();
+	if (IsEmpty(new_area)) {
+		return;
+	}
+	AddRectangle(damage_, new_area);
+}
+
+void LayerManager::Flush() {
 	for (auto layer : layer_stack_) {
-		if (layer->ID() == id) {
-			window_area.size = layer->GetWindow()->Size();
-			window_area.pos = layer->GetPosition();
-			draw = true;
+		if (auto window = layer->GetWindow()) {
+			const auto dirty = window->DirtyArea();
+			AddDamage({layer->GetPosition() + dirty.pos, dirty.size});
+		}
+	}
+	// 1つのウィンドウが複数のレイヤに設定されている場合に備え、記録の消去は全レイヤの走査後に行う
+	// 非表示のレイヤは再表示する際にUpDownで領域全体を記録するので、書き換え領域を捨ててよい
+	for (auto& slot : layers_) {
+		if (!slot.layer) {
+			continue;
 		}
-		if (draw) {
-			layer->DrawTo(back_buffer_, window_area);
+		if (auto window = slot.layer->GetWindow()) {
+			window->ClearDirtyArea();
 		}
 	}
-	screen_->Copy(window_area.pos, back_buffer_, window_area);
+	if (cursor_ && !IsEmpty(cursor_->DirtyArea())) {
+		cursor_->ClearDirtyArea();
+		QueuePresent(CursorArea());
+	}
+
+	for (const auto& area : damage_) {
+		Draw(area);
+	}
+	damage_.clear();
+	Present();
+}
+
+void LayerManager::Present() {
+	if (present_.empty()) {
+		return;
+	}
+
+	// カーソルと重なる部分は最後にカーソルと合成して送るので、ここでは送らない
+	const auto cursor_area = CursorArea();
+	bool draw_cursor = false;
+	present_pieces_.clear();
+	for (const auto& area : present_) {
+		if (IsEmpty(area & cursor_area)) {
+			present_pieces_.push_back(area);
+			continue;
+		}
+		draw_cursor = true;
+		SubtractRectangle(area, cursor_area, present_pieces_);
+	}
+	present_.clear();
+
+	// 画面の上から下へ順に書き込む
+	std::sort(present_pieces_.begin(), present_pieces_.end(),
+			  [](const Rectangle<int>& lhs, const Rectangle<int>& rhs) {
+				  return lhs.pos.y != rhs.pos.y ? lhs.pos.y < rhs.pos.y : lhs.pos.x < rhs.pos.x;
+			  });
+	size_t bytes = 0;
+	for (const auto& piece : present_pieces_) {
+		screen_->Copy(piece.pos, back_buffer_, piece);
+		bytes += 4 * piece.size.x * piece.size.y;
+	}
+	if (draw_cursor) {
+		DrawCursor(cursor_area);
+		bytes += 4 * cursor_area.size.x * cursor_area.size.y;
+	}
+
+	present_stats_.rects = present_pieces_.size() + (draw_cursor ? 1 : 0);
+	present_stats_.bytes = bytes;
+	++present_stats_.frames;
+	present_stats_.total_bytes += bytes;
+}
+
+const LayerManager::PresentStats& LayerManager::LastPresentStats() const {
+	return present_stats_;
 }
 
 void LayerManager::Move(unsigned int id, Vector2D<int> new_pos) {
 	auto layer = FindLayer(id);
-	const auto window_size = layer->GetWindow()->Size();
-	const auto old_pos = layer->GetPosition();
+	if (!layer) {
+		return;
+	}
+	if (layer->height_ < 0) {
+		layer->Move(new_pos);
+		return;
+	}
+
+	const auto old_area = LayerArea(*layer);
+	RemoveFromTiles(layer, old_area);
 	layer->Move(new_pos);
-	Draw({old_pos, window_size});
-	Draw(id);
+	InsertIntoTiles(layer);
+	AddDamage(old_area);
+	AddDamage(LayerArea(*layer));
 }
 
-Layer* LayerManager::FindLayerByPosition(Vector2D<int> pos, unsigned int exclude_id) const {
-	auto pred = [pos, exclude_id](Layer* layer) {
-		if (layer->ID() == exclude_id) {
-			return false;
-		}
-		const auto& win = layer->GetWindow();
-		if (!win) {
-			return false;
-		}
-		const auto win_pos = layer->GetPosition();
-		const auto win_end_pos = win_pos + win->Size();
-		return win_pos.x <= pos.x && pos.x < win_end_pos.x &&
-			   win_pos.y <= pos.y && pos.y < win_end_pos.y;
+void LayerManager::SetWindow(unsigned int id, const std::shared_ptr<Window>& window) {
+	auto layer = FindLayer(id);
+	if (!layer) {
+		return;
+	}
+	if (layer->height_ < 0) {
+		layer->SetWindow(window);
+		return;
+	}
+
+	const auto old_area = LayerArea(*layer);
+	RemoveFromTiles(layer, old_area);
+	layer->SetWindow(window);
+	InsertIntoTiles(layer);
+	AddDamage(old_area);
+	AddDamage(LayerArea(*layer));
+}
+
+void LayerManager::SetOpacity(unsigned int id, uint8_t opacity) {
+	auto layer = FindLayer(id);
+	if (!layer || layer->Opacity() == opacity) {
+		return;
+	}
+
+	layer->SetOpacity(opacity);
+	if (layer->height_ >= 0) {
+		AddDamage(LayerArea(*layer));
+	}
+}
+
+Layer* LayerManager::FindLayerByPosition(Vector2D<int> pos) const {
+	if (pos.x < 0 || pos.y < 0) {
+		return nullptr;
+	}
+	const Vector2D<int> tile_pos{pos.x / kTileSize, pos.y / kTileSize};
+	if (tile_pos.x >= tile_count_.x || tile_pos.y >= tile_count_.y) {
+		return nullptr;
+	}
+
+	auto pred = [this, pos](Layer* layer) {
+		const auto area = LayerArea(*layer);
+		const auto end_pos = area.pos + area.size;
+		return area.pos.x <= pos.x && pos.x < end_pos.x &&
+			   area.pos.y <= pos.y && pos.y < end_pos.y;
 	};
-	auto it = std::find_if(layer_stack_.rbegin(), layer_stack_.rend(), pred);
-	if (it == layer_stack_.rend()) {
+	const auto& tile = tiles_[tile_pos.y * tile_count_.x + tile_pos.x];
+	auto it = std::find_if(tile.rbegin(), tile.rend(), pred);
+	if (it == tile.rend()) {
 		return nullptr;
 	}
 	return *it;
@@ -120,11 +433,10 @@ Layer* LayerManager::FindLayerByPosition(Vector2D<int> pos, unsigned int exclude
 
 void LayerManager::MoveRelative(unsigned int id, Vector2D<int> pos_diff) {
 	auto layer = FindLayer(id);
-	const auto window_size = layer->GetWindow()->Size();
-	const auto old_pos = layer->GetPosition();
-	layer->MoveRelative(pos_diff);
-	Draw({old_pos, window_size});
-	Draw(id);
+	if (!layer) {
+		return;
+	}
+	Move(id, layer->GetPosition() + pos_diff);
 }
 
 void LayerManager::UpDown(unsigned int id, int new_height) {
@@ -132,43 +444,160 @@ void LayerManager::UpDown(unsigned int id, int new_height) {
 		Hide(id);
 		return;
 	}
-	if (new_height > layer_stack_.size()) {
-		new_height = layer_stack_.size();
-	}
 
 	auto layer = FindLayer(id);
-	auto old_pos = std::find(layer_stack_.begin(), layer_stack_.end(), layer);
-	auto new_pos = layer_stack_.begin() + new_height;
-
-	if (old_pos == layer_stack_.end()) {
-		layer_stack_.insert(new_pos, layer);
+	if (!layer) {
 		return;
 	}
-
-	if (new_pos == layer_stack_.end()) {
-		--new_pos;
+	const auto area = LayerArea(*layer);
+	AddDamage(area);
+
+	// 表示中なら一旦スタックから取り除いてから、指定された高さに挿入する
+	const int old_height = layer->height_;
+	if (old_height >= 0) {
+		RemoveFromTiles(layer, area);
+		layer_stack_.erase(layer_stack_.begin() + old_height);
 	}
-	layer_stack_.erase(old_pos);
-	layer_stack_.insert(new_pos, layer);
+	new_height = std::min(new_height, static_cast<int>(layer_stack_.size()));
+	layer_stack_.insert(layer_stack_.begin() + new_height, layer);
+
+	RenumberHeights(old_height >= 0 ? std::min(old_height, new_height) : new_height);
+	InsertIntoTiles(layer);
 }
 
 void LayerManager::Hide(unsigned int id) {
 	auto layer = FindLayer(id);
-	auto pos = std::find(layer_stack_.begin(), layer_stack_.end(), layer);
-	if (pos != layer_stack_.end()) {
-		layer_stack_.erase(pos);
+	if (!layer || layer->height_ < 0) {
+		return;
 	}
+	const int height = layer->height_;
+
+	const auto area = LayerArea(*layer);
+	AddDamage(area);
+	RemoveFromTiles(layer, area);
+	layer_stack_.erase(layer_stack_.begin() + height);
+	layer->height_ = -1;
+	RenumberHeights(height);
 }
 
-Layer* LayerManager::FindLayer(unsigned int id) {
-	auto pred = [id](const std::unique_ptr<Layer>& elem) {
-		return elem->ID() == id;
-	};
-	auto it = std::find_if(layers_.begin(), layers_.end(), pred);
-	if (it == layers_.end()) {
+void LayerManager::SetTiledComposition(bool enabled) {
+	tiled_ = enabled;
+}
+
+Layer* LayerManager::FindLayer(unsigned int id) const {
+	const size_t slot_number = id & ((1u << kSlotBits) - 1);
+	if (slot_number == 0 || slot_number > layers_.size()) {
+		return nullptr;
+	}
+	// 世代番号も含めてIDが一致しなければ、スロットは既に別のレイヤに再利用されている
+	const auto& slot = layers_[slot_number - 1];
+	if (!slot.layer || slot.layer->ID() != id) {
 		return nullptr;
 	}
-	return it->get();
+	return slot.layer.get();
+}
+
+void LayerManager::RenumberHeights(size_t from) {
+	for (size_t i = from; i < layer_stack_.size(); ++i) {
+		layer_stack_[i]->height_ = i;
+	}
+}
+
+void LayerManager::SetCursor(const std::shared_ptr<Window>& cursor) {
+	cursor_ = cursor;
+
+	FrameBufferConfig config = screen_->Config();
+	config.frame_buffer = nullptr;
+	config.horizontal_resolution = cursor->Width();
+	config.vertical_resolution = cursor->Height();
+	if (auto err = cursor_buffer_.Initialize(config)) {
+		Log(kError, "failed to initialize cursor buffer: %s at %s:%d\n",
+			err.Name(), err.File(), err.Line());
+	}
+	cursor_->ClearDirtyArea();
+	QueuePresent(CursorArea());
+}
+
+void LayerManager::MoveCursor(Vector2D<int> pos) {
+	QueuePresent(CursorArea());
+	cursor_pos_ = pos;
+	QueuePresent(CursorArea());
+}
+
+Rectangle<int> LayerManager::CursorArea() const {
+	if (!cursor_) {
+		return {};
+	}
+	return Rectangle<int>{cursor_pos_, cursor_->Size()} & ScreenArea();
+}
+
+Rectangle<int> LayerManager::ScreenArea() const {
+	return {{0, 0}, {
+		static_cast<int>(screen_->Config().horizontal_resolution),
+		static_cast<int>(screen_->Config().vertical_resolution)}};
+}
+
+void LayerManager::QueuePresent(const Rectangle<int>& area) const {
+	const auto new_area = area & ScreenArea();
+	if (IsEmpty(new_area)) {
+		return;
+	}
+	AddRectangle(present_, new_area);
+}
+
+void LayerManager::DrawCursor(const Rectangle<int>& area) const {
+	if (!cursor_ || IsEmpty(area)) {
+		return;
+	}
+	cursor_buffer_.Copy({0, 0}, back_buffer_, area);
+	cursor_->DrawTo(cursor_buffer_, cursor_pos_ - area.pos, {{0, 0}, area.size});
+	screen_->Copy(area.pos, cursor_buffer_, {{0, 0}, area.size});
+}
+
+Rectangle<int> LayerManager::TileRange(const Rectangle<int>& area) const {
+	if (IsEmpty(area)) {
+		return {};
+	}
+	const auto begin = ElementMax(Vector2D<int>{area.pos.x / kTileSize, area.pos.y / kTileSize},
+								  Vector2D<int>{0, 0});
+	const auto end = ElementMin(
+		Vector2D<int>{(area.pos.x + area.size.x + kTileSize - 1) / kTileSize,
+					  (area.pos.y + area.size.y + kTileSize - 1) / kTileSize},
+		tile_count_);
+	return {begin, ElementMax(end - begin, Vector2D<int>{0, 0})};
+}
+
+void LayerManager::RemoveFromTiles(Layer* layer, const Rectangle<int>& area) {
+	const auto range = TileRange(area);
+	for (int ty = range.pos.y; ty < range.pos.y + range.size.y; ++ty) {
+		for (int tx = range.pos.x; tx < range.pos.x + range.size.x; ++tx) {
+			auto& tile = tiles_[ty * tile_count_.x + tx];
+			auto it = std::find(tile.begin(), tile.end(), layer);
+			if (it != tile.end()) {
+				tile.erase(it);
+			}
+		}
+	}
+}
+
+void LayerManager::InsertIntoTiles(Layer* layer) {
+	// 他のレイヤの高さが変わっても相対的な順序は変わらないので、タイル内の配列は高さ順のまま保たれる
+	auto lower = [](const Layer* lhs, const Layer* rhs) { return lhs->height_ < rhs->height_; };
+	const auto range = TileRange(LayerArea(*layer));
+	for (int ty = range.pos.y; ty < range.pos.y + range.size.y; ++ty) {
+		for (int tx = range.pos.x; tx < range.pos.x + range.size.x; ++tx) {
+			auto& tile = tiles_[ty * tile_count_.x + tx];
+			tile.insert(std::lower_bound(tile.begin(), tile.end(), layer, lower), layer);
+		}
+	}
+}
+
+Rectangle<int> LayerManager::LayerArea(const Layer& layer) const {
+	// GetWindowはshared_ptrの複製で参照カウントを操作するので、頻繁に呼ばれるここでは直接参照する
+	if (layer.window_) {
+		return {layer.pos_, layer.window_->Size()};
+	}
+	return {layer.pos_, {0, 0}};
 }
 
 namespace {
@@ -184,8 +613,10 @@ void InitializeLayer() {
 		screen_size.x, screen_size.y, screen_config.pixel_format);
 	DrawDesktop(*bgwindow->Writer());
 
+	// 画面下端の50ピクセルを除いた範囲にコンソールを広げる
+	console->Resize((screen_size.y - 50) / 16, screen_size.x / 8);
 	auto console_window = std::make_shared<Window>(
-		Console::kColumns * 8, Console::kRows * 16, screen_config.pixel_format);
+		console->Columns() * 8, console->Rows() * 16, screen_config.pixel_format);
 	console->SetWindow(console_window);
 
 	screen = new FrameBuffer;
@@ -203,7 +634,7 @@ void InitializeLayer() {
 		.Move({0, 0})
 		.ID();
 	console->SetLayerID(layer_manager->NewLayer()
-		.SetWindow(bgwindow)
+		.SetWindow(console_window)
 		.Move({0, 0})
 		.ID());
 
@@ -48,6 +48,16 @@ public:
 	 */
 	bool IsDraggable() const;
 
+	/**
+	 * @brief レイヤ全体の不透明度を設定する。255で不透明、0で完全に透明。再描画はしない
+	 */
+	Layer& SetOpacity(uint8_t opacity);
+
+	/**
+	 * @brief レイヤ全体の不透明度を返す
+	 */
+	uint8_t Opacity() const;
+
 	/**
 	 * @brief レイヤの位置情報を指定した絶対座標へと更新する。再描画はしない
 	 */
@@ -58,20 +68,49 @@ public:
 	 */
 	Layer& MoveRelative(Vector2D<int> pos_diff);
 
+	/**
+	 * @brief レイヤの高さ(layer_stack_内の位置)を返す。非表示なら-1を返す
+	 */
+	int Height() const;
+
 	/**
 	 * @brief writerに現在設定されているウィンドウの内容を描画する
 	 */
 	void DrawTo(FrameBuffer& screen, const Rectangle<int>& area) const;
 
+	/**
+	 * @brief 描画するとウィンドウの領域全体を覆い隠すならtrueを返す
+	 */
+	bool IsOpaque() const;
+
+	/**
+	 * @brief 描画すると下の内容と合成するならtrueを返す
+	 *
+	 * 合成するレイヤを描画済みの内容の上へもう一度描くと、前回の自分の出力とも合成されて色がずれる
+	 */
+	bool IsBlended() const;
+
 private:
 	unsigned int id_;
 	Vector2D<int> pos_{};
 	std::shared_ptr<Window> window_{};
 	bool draggable_{false};
+	uint8_t opacity_{255};
+	// LayerManagerが重ね順を変えるたびに更新する
+	int height_{-1};
+
+	friend class LayerManager;
 };
 
 class LayerManager {
 public:
+	// タイル単位の合成で画面を分割するタイルの1辺のピクセル数
+	static const int kTileSize = 64;
+	// レイヤIDの下位ビットのうち、layers_のスロット番号+1を表すビット数。残りの上位ビットは世代番号
+	static const unsigned int kSlotBits = 16;
+	// 同時に存在できるレイヤの最大数。スロット番号+1がkSlotBitsビットに収まる数
+	static const size_t kMaxLayers = (1u << kSlotBits) - 1;
+
 	/**
 	 * @brief Drawメソッドなどで描画する際の描画先を設定する
 	 */
@@ -79,29 +118,92 @@ public:
 
 	/**
 	 * @brief 新しいレイヤを生成して参照を返す
+	 *
+	 * 既にkMaxLayers個のレイヤが存在する場合はエラーを記録して停止する
 	 */
 	Layer& NewLayer();
 
+	/**
+	 * @brief レイヤを非表示にしてから破棄する
+	 *
+	 * 破棄したレイヤのスロットは再利用されるが、世代番号が変わるので古いIDで新しいレイヤを操作することはない
+	 * 破棄したレイヤのIDを渡したMoveやUpDownなどの操作は何もしない
+	 */
+	void RemoveLayer(unsigned int id);
+
 	/**
 	 * @brief 現在表示状態にあるレイヤを描画する
+	 *
+	 * 合成するのはback_buffer_までで、画面への転送は次のPresentで行う
 	 */
 	void Draw(const Rectangle<int>& area) const;
 
 	/**
 	 * @brief 指定したレイヤーに設定されているウィンドウの描画領域内を再描画する
+	 *
+	 * 通常は指定したレイヤから上だけを描く。下と合成するレイヤは、その領域を最下層から描き直す
+	 * 合成するのはback_buffer_までで、画面への転送は次のPresentで行う
 	 */
 	void Draw(unsigned int id) const;
 
 	/**
-	 * @brief レイヤの位置情報を指定した絶対座標へと更新する。再描画する
+	 * @brief 再描画が必要な領域を記録する。実際の描画はFlushで行う
+	 *
+	 * 重なり合う領域は1つの矩形にまとめられる
+	 */
+	void AddDamage(const Rectangle<int>& area);
+
+	/**
+	 * @brief 記録された再描画領域と、各ウィンドウで書き換えられた領域だけを再描画し、Presentする
+	 *
+	 * メインループの1周に1回呼ぶ
+	 */
+	void Flush();
+
+	/**
+	 * @brief 前回から合成した領域とカーソルの移動をまとめて画面へ転送する
+	 *
+	 * 転送する矩形は互いに重ならないようにまとめてから画面の上から順に並べ、
+	 * VRAMへはキャッシュを経由しないストア命令で1度ずつ書き込む
+	 * カーソルと重なる部分は最後にカーソルと合成したものを書き込むので、カーソルがちらつかない
+	 */
+	void Present();
+
+	// Presentで画面へ転送した量の統計
+	struct PresentStats {
+		// 直前のPresentで転送した矩形の数とバイト数
+		size_t rects, bytes;
+		// Presentで何かを転送した回数と、これまでに転送したバイト数の合計
+		uint64_t frames, total_bytes;
+	};
+
+	/**
+	 * @brief Presentで画面へ転送した量の統計を返す
+	 */
+	const PresentStats& LastPresentStats() const;
+
+	/**
+	 * @brief レイヤの位置情報を指定した絶対座標へと更新する。移動前後の領域を再描画領域として記録する
 	 */
 	void Move(unsigned int id, Vector2D<int> new_pos);
 
 	/**
-	 * @brief レイヤの位置情報を指定した相対座標へと更新する。再描画する
+	 * @brief レイヤの位置情報を指定した相対座標へと更新する。移動前後の領域を再描画領域として記録する
 	 */
 	void MoveRelative(unsigned int id, Vector2D<int> pos_diff);
 
+	/**
+	 * @brief レイヤに表示するウィンドウを差し替える。差し替え前後の領域を再描画領域として記録する
+	 *
+	 * 大きさの異なるウィンドウに差し替える場合はLayer::SetWindowではなくこちらを使う
+	 */
+	void SetWindow(unsigned int id, const std::shared_ptr<Window>& window);
+
+	/**
+	 * @brief レイヤ全体の不透明度を変える。表示中ならレイヤの領域を再描画領域として記録する
+	 */
+	void SetOpacity(unsigned int id, uint8_t opacity);
+
 	/**
 	 * @brief レイヤの高さ方向の位置を指定した位置に移動する
 	 * 
@@ -115,18 +217,139 @@ public:
 	 */
 	void Hide(unsigned int id);
 
-	Layer* FindLayerByPosition(Vector2D<int> pos, unsigned int exclude_id) const;
+	/**
+	 * @brief 指定した位置を含む表示中のレイヤのうち、最前面のものを返す。なければnullptrを返す
+	 *
+	 * posを含むタイルに記録されたレイヤだけを上から調べるので、処理時間は全レイヤ数によらない
+	 */
+	Layer* FindLayerByPosition(Vector2D<int> pos) const;
+
+	/**
+	 * @brief trueでタイル単位の合成を有効にする
+	 *
+	 * 画面はkTileSize四方のタイルに分けられ、タイルごとに重なっているレイヤが下から順に記録されている
+	 * 有効にすると、再描画の際にタイルごとにそのタイルと重なるレイヤだけを走査する。レイヤが多いときに有効
+	 * 既定では無効。数個のレイヤではタイルごとに分ける分だけ遅くなるので、カーネルは有効にしていない
+	 */
+	void SetTiledComposition(bool enabled);
+
+	/**
+	 * @brief マウスカーソルとして全レイヤの上に重ねて表示するウィンドウを設定する
+	 *
+	 * カーソルはレイヤとしては扱わず、back_buffer_にも描画しない
+	 * back_buffer_がカーソルの下にある内容をそのまま保持しているので、移動時はそこから元の画面を復元できる
+	 */
+	void SetCursor(const std::shared_ptr<Window>& cursor);
+
+	/**
+	 * @brief カーソルを指定した位置へ移動する
+	 *
+	 * 移動前後の領域を次のPresentで画面へ転送する。レイヤの合成はしないので、処理時間は表示しているレイヤ数によらない
+	 */
+	void MoveCursor(Vector2D<int> pos);
 
 private:
 	FrameBuffer* screen_{nullptr};
 	mutable FrameBuffer back_buffer_{};
-	// 存在するすべてのレイヤを格納する配列
-	std::vector<std::unique_ptr<Layer>> layers_{};
+	// レイヤを格納するスロット。レイヤIDからスロットを直接引ける
+	struct LayerSlot {
+		std::unique_ptr<Layer> layer;
+		// スロットが再利用されるたびに1増える
+		unsigned int generation;
+	};
+	// 存在するすべてのレイヤを格納する配列。破棄されたレイヤのスロットはlayerがnullptrになる
+	std::vector<LayerSlot> layers_{};
+	// 空いているスロットの番号
+	std::vector<size_t> free_slots_{};
 	// 先頭の要素を再背面レイヤ、そこから順に積んでいって、末尾を最前面とするスタック。非表示は含まない
+	// 各レイヤのheight_はこの配列内の位置と一致させる
 	std::vector<Layer*> layer_stack_{};
-	unsigned int latest_id_{0};
+	// 次のFlushで再描画する領域。互いに重ならない矩形の集合
+	std::vector<Rectangle<int>> damage_{};
+	// DrawLayersの作業領域。描画のたびにメモリを確保しないよう使い回す
+	mutable std::vector<Rectangle<int>> uncovered_{}, uncovered_next_{};
+	mutable std::vector<std::pair<Layer*, Rectangle<int>>> draw_list_{};
+	std::shared_ptr<Window> cursor_{};
+	Vector2D<int> cursor_pos_{};
+	// back_buffer_の内容とカーソルを合成してから画面へ送るための作業領域
+	mutable FrameBuffer cursor_buffer_{};
+	// 次のPresentで画面へ転送する領域。互いに重ならない矩形の集合
+	mutable std::vector<Rectangle<int>> present_{};
+	// Presentの作業領域
+	std::vector<Rectangle<int>> present_pieces_{};
+	PresentStats present_stats_{};
+	// タイル単位の合成が有効ならtrue
+	bool tiled_{false};
+	// 横方向と縦方向のタイル数
+	Vector2D<int> tile_count_{};
+	// タイルごとの、そのタイルと重なる表示中のレイヤの配列。並び順はlayer_stack_と同じ
+	// 合成の有無によらず、Move、UpDown、Hideのたびに影響するタイルだけ更新する
+	// 表示中のレイヤにSetWindowやLayer::Moveを直接使った場合は更新されない
+	std::vector<std::vector<Layer*>> tiles_{};
+
+	/**
+	 * @brief IDからレイヤを探す。スロット番号と世代番号を照合するだけなので、レイヤ数によらず一定時間で終わる
+	 *
+	 * 破棄済みのレイヤのIDならnullptrを返す。IDを受け取る公開メソッドはその場合何もしない
+	 */
+	Layer* FindLayer(unsigned int id) const;
+
+	/**
+	 * @brief layer_stack_[from]以降のレイヤの高さを配列内の位置に合わせる
+	 */
+	void RenumberHeights(size_t from);
+
+	/**
+	 * @brief [first, last)のレイヤのうち、area内で実際に見えている部分だけをback_buffer_に描画する
+	 *
+	 * 上のレイヤから順に、不透明なレイヤが覆う領域を描画対象から取り除いていく
+	 * 完全に隠れたレイヤやその一部には一切触れない
+	 */
+	void DrawLayers(std::vector<Layer*>::const_iterator first,
+					std::vector<Layer*>::const_iterator last,
+					const Rectangle<int>& area) const;
+
+	/**
+	 * @brief レイヤに設定されたウィンドウが画面上で占める領域を返す
+	 */
+	Rectangle<int> LayerArea(const Layer& layer) const;
 
-	Layer* FindLayer(unsigned int id);
+	/**
+	 * @brief カーソルが画面上で占める領域を返す。カーソルがなければ空の矩形を返す
+	 */
+	Rectangle<int> CursorArea() const;
+
+	/**
+	 * @brief 画面全体の領域を返す
+	 */
+	Rectangle<int> ScreenArea() const;
+
+	/**
+	 * @brief areaのうち画面内の部分を、次のPresentで画面へ転送する領域に加える
+	 */
+	void QueuePresent(const Rectangle<int>& area) const;
+
+	/**
+	 * @brief area内にあるback_buffer_の内容にカーソルを重ね、画面へ送る
+	 *
+	 * areaはcursor_buffer_に収まる大きさ(カーソルの大きさ以下)でなければならない
+	 */
+	void DrawCursor(const Rectangle<int>& area) const;
+
+	/**
+	 * @brief areaと重なるタイルの範囲を、タイル単位の座標で返す
+	 */
+	Rectangle<int> TileRange(const Rectangle<int>& area) const;
+
+	/**
+	 * @brief areaと重なるタイルの配列からlayerを取り除く
+	 */
+	void RemoveFromTiles(Layer* layer, const Rectangle<int>& area);
+
+	/**
+	 * @brief layerと重なるタイルの配列に、高さの順を保つようにlayerを挿入する
+	 */
+	void InsertIntoTiles(Layer* layer);
 };
 
 extern LayerManager* layer_manager;
@@ -0,0 +1,268 @@
+/**
+ * @file log_ring.cpp
+ */
+#include "log_ring.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+	uint64_t ReadTimestampCounter() {
+		uint32_t lo, hi;
+		__asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+		return (static_cast<uint64_t>(hi) << 32) | lo;
+	}
+
+	/**
+	 * @brief 書式文字列中の1個の変換指定(%から変換文字まで)
+	 */
+	struct ConversionSpec {
+		const char* begin;		// '%'の位置
+		const char* end;		// 変換文字の次の位置
+		int num_stars;			// 幅と精度に使われた'*'の数
+		bool is_long;			// l, ll, z, j, tのいずれかで64ビットの引数を取る
+		char conversion;		// 変換文字
+	};
+
+	bool IsFlag(char c) {
+		return c == '-' || c == '+' || c == ' ' || c == '#' || c == '0';
+	}
+
+	bool IsDigit(char c) {
+		return '0' <= c && c <= '9';
+	}
+
+	/**
+	 * @brief pが指す'%'から始まる変換指定を解釈する。"%%"はconversionが'%'になる
+	 */
+	ConversionSpec ParseSpec(const char* p) {
+		ConversionSpec spec{p, p, 0, false, '\0'};
+		++p;
+		while (IsFlag(*p)) {
+			++p;
+		}
+		if (*p == '*') {
+			++spec.num_stars;
+			++p;
+		}
+		while (IsDigit(*p)) {
+			++p;
+		}
+		if (*p == '.') {
+			++p;
+			if (*p == '*') {
+				++spec.num_stars;
+				++p;
+			}
+			while (IsDigit(*p)) {
+				++p;
+			}
+		}
+		while (*p == 'h' || *p == 'l' || *p == 'z' || *p == 'j' || *p == 't') {
+			spec.is_long |= *p != 'h';
+			++p;
+		}
+		if (*p != '\0') {
+			spec.conversion = *p++;
+		}
+		spec.end = p;
+		return spec;
+	}
+
+	bool IsFloatConversion(char c) {
+		return c == 'f' || c == 'F' || c == 'e' || c == 'E' ||
+			   c == 'g' || c == 'G' || c == 'a' || c == 'A';
+	}
+
+	/**
+	 * @brief 変換指定をsnprintfにそのまま渡せる文字列にする。'*'は記録した値で置き換える
+	 */
+	void CopySpec(char* dst, size_t size, const ConversionSpec& spec, const uint64_t* stars) {
+		size_t n = 0;
+		int star = 0;
+		for (const char* p = spec.begin; p != spec.end && n + 1 < size; ++p) {
+			if (*p == '*') {
+				n += snprintf(dst + n, size - n, "%d", static_cast<int>(stars[star++]));
+				n = n < size ? n : size - 1;
+			} else {
+				dst[n++] = *p;
+			}
+		}
+		dst[n] = '\0';
+	}
+}
+
+void LogRing::Append(LogLevel level, const char* format, va_list ap) {
+	const uint64_t seq = head_.fetch_add(1, std::memory_order_relaxed);
+	Record& record = records_[seq % kCapacity];
+	record.sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	Payload& payload = record.payload;
+	payload.timestamp = ReadTimestampCounter();
+	payload.format = format;
+	payload.level = level;
+	payload.num_args = 0;
+
+	size_t string_pos = 0;
+	for (const char* p = format; *p != '\0'; ++p) {
+		if (*p != '%') {
+			continue;
+		}
+		const auto spec = ParseSpec(p);
+		p = spec.end - 1;
+		if (spec.conversion == '%' || spec.conversion == '\0') {
+			continue;
+		}
+		if (payload.num_args + spec.num_stars + 1 > kMaxArgs) {
+			break;
+		}
+
+		for (int i = 0; i < spec.num_stars; ++i) {
+			payload.args[payload.num_args++] = va_arg(ap, int);
+		}
+
+		uint64_t value = 0;
+		switch (spec.conversion) {
+		case 's': {
+			const char* s = va_arg(ap, const char*);
+			if (s == nullptr) {
+				s = "(null)";
+			}
+			// 最後の1バイトは常に'\0'のままにしておき、収まらない文字列はそこを指す
+			const size_t room = kStringBytes - 1 - string_pos;
+			const size_t len = strnlen(s, room > 0 ? room - 1 : 0);
+			value = room > 0 ? string_pos : kStringBytes - 1;
+			if (room > 0) {
+				memcpy(&payload.strings[string_pos], s, len);
+				payload.strings[string_pos + len] = '\0';
+				string_pos += len + 1;
+			}
+			break;
+		}
+		case 'p':
+			value = reinterpret_cast<uintptr_t>(va_arg(ap, void*));
+			break;
+		case 'n':
+			// 書き込み先のポインタは後で使えないので読み飛ばすだけにする
+			va_arg(ap, void*);
+			continue;
+		default:
+			if (IsFloatConversion(spec.conversion)) {
+				const double d = va_arg(ap, double);
+				memcpy(&value, &d, sizeof(value));
+			} else if (spec.is_long) {
+				value = va_arg(ap, uint64_t);
+			} else {
+				value = va_arg(ap, unsigned int);
+			}
+		}
+		payload.args[payload.num_args++] = value;
+	}
+	payload.strings[kStringBytes - 1] = '\0';
+
+	record.sequence.store(seq + 1, std::memory_order_release);
+}
+
+bool LogRing::Pop(char* buf, size_t size, uint64_t* timestamp) {
+	const uint64_t head = head_.load(std::memory_order_acquire);
+	if (tail_ == head) {
+		return false;
+	}
+	if (head - tail_ > kCapacity) {
+		const uint64_t lost = head - kCapacity - tail_;
+		tail_ = head - kCapacity;
+		snprintf(buf, size, "(%lu log records lost)\n", static_cast<unsigned long>(lost));
+		return true;
+	}
+
+	// 書き込み途中でなければ中身を複製し、複製している間に上書きされなかったことを確かめる
+	Record& record = records_[tail_ % kCapacity];
+	const uint64_t seq = record.sequence.load(std::memory_order_acquire);
+	if (seq != tail_ + 1) {
+		if (seq > tail_ + 1) {
+			++tail_;
+			snprintf(buf, size, "(1 log record lost)\n");
+			return true;
+		}
+		return false;
+	}
+	Payload payload;
+	memcpy(&payload, &record.payload, sizeof(payload));
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (record.sequence.load(std::memory_order_relaxed) != seq) {
+		++tail_;
+		snprintf(buf, size, "(1 log record lost)\n");
+		return true;
+	}
+	++tail_;
+
+	if (timestamp) {
+		*timestamp = payload.timestamp;
+	}
+
+	// 書式文字列の地の文はそのまま、変換指定は1個ずつsnprintfで書式化してつなげる
+	size_t n = 0;
+	int arg = 0;
+	const char* p = payload.format;
+	while (*p != '\0' && n + 1 < size) {
+		if (*p != '%') {
+			buf[n++] = *p++;
+			continue;
+		}
+
+		const auto spec = ParseSpec(p);
+		p = spec.end;
+		if (spec.conversion == '%') {
+			buf[n++] = '%';
+			continue;
+		}
+		if (spec.conversion == 'n' || spec.conversion == '\0') {
+			continue;
+		}
+		if (arg + spec.num_stars + 1 > payload.num_args) {
+			break;
+		}
+
+		char spec_str[32];
+		CopySpec(spec_str, sizeof(spec_str), spec, &payload.args[arg]);
+		arg += spec.num_stars;
+		const uint64_t value = payload.args[arg++];
+
+		char* out = buf + n;
+		const size_t room = size - n;
+		int written;
+		switch (spec.conversion) {
+		case 'd':
+		case 'i':
+			written = spec.is_long
+				? snprintf(out, room, spec_str, static_cast<long long>(value))
+				: snprintf(out, room, spec_str, static_cast<int>(value));
+			break;
+		case 's':
+			written = snprintf(out, room, spec_str, &payload.strings[value]);
+			break;
+		case 'p':
+			written = snprintf(out, room, spec_str, reinterpret_cast<void*>(value));
+			break;
+		case 'c':
+			written = snprintf(out, room, spec_str, static_cast<int>(value));
+			break;
+		default:
+			if (IsFloatConversion(spec.conversion)) {
+				double d;
+				memcpy(&d, &value, sizeof(d));
+				written = snprintf(out, room, spec_str, d);
+			} else if (spec.is_long) {
+				written = snprintf(out, room, spec_str, static_cast<unsigned long long>(value));
+			} else {
+				written = snprintf(out, room, spec_str, static_cast<unsigned int>(value));
+			}
+		}
+		if (written > 0) {
+			n += static_cast<size_t>(written) < room ? written : room - 1;
+		}
+	}
+	buf[n] = '\0';
+	return true;
+}
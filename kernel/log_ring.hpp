@@ -0,0 +1,73 @@
+/**
+ * @file log_ring.hpp
+ *
+ * 書式化前のログを溜めておくリングバッファ
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include "logger.hpp"
+
+/**
+ * @brief ログの書式文字列と引数を書式化せずに記録するリングバッファ
+ *
+ * Appendは書き込む場所をアトミックな加算で確保するだけでロックを取らないので、
+ * 割り込みハンドラの中からでも呼べる。書式化と画面への出力はPopを呼んだときに行う
+ * 取り出す側(Pop)はメインループなど1か所に限る
+ */
+class LogRing {
+public:
+	// 保持できるレコード数。溢れたら古いものから上書きする
+	static const size_t kCapacity = 256;
+	// 1レコードに記録できる引数の数(幅や精度の'*'も1個と数える)
+	static const int kMaxArgs = 8;
+	// 1レコードの%s引数の文字列を複製しておく領域の大きさ
+	static const size_t kStringBytes = 96;
+
+	/**
+	 * @brief ログを1件記録する
+	 *
+	 * formatを解釈して引数をva_argで読み出し、生の値のまま保存する
+	 * %sの文字列は呼び出し元で書き換えられてもよいようにレコード内へ複製する(収まらない分は切り捨てる)
+	 * formatそのものは複製しないので、文字列リテラルなど消えない文字列を渡すこと
+	 */
+	void Append(LogLevel level, const char* format, va_list ap);
+
+	/**
+	 * @brief 最も古い未出力のレコードを書式化してbufに書き込む
+	 *
+	 * @param buf		書式化した文字列の書き込み先
+	 * @param size		bufの大きさ
+	 * @param timestamp	nullptrでなければ、記録した時点のタイムスタンプカウンタの値を書き込む
+	 * @return レコードを取り出せたらtrue。未出力のレコードがないか、書き込み途中ならfalse
+	 *
+	 * 上書きされて失われたレコードがあれば、その件数を知らせる文字列を1件分として返す
+	 */
+	bool Pop(char* buf, size_t size, uint64_t* timestamp = nullptr);
+
+private:
+	struct Payload {
+		uint64_t timestamp;
+		const char* format;
+		LogLevel level;
+		int num_args;
+		uint64_t args[kMaxArgs];
+		// %s引数の複製。argsにはこの配列内の位置を入れる
+		char strings[kStringBytes];
+	};
+
+	struct Record {
+		// 書き込み済みならそのレコードの通し番号+1、書き込み中なら0
+		std::atomic<uint64_t> sequence;
+		Payload payload;
+	};
+
+	Record records_[kCapacity];
+	// 次に確保する通し番号
+	std::atomic<uint64_t> head_{0};
+	// 次に取り出す通し番号
+	uint64_t tail_{0};
+};
@@ -7,9 +7,12 @@
 #include <cstdio>
 
 #include "console.hpp"
+#include "log_ring.hpp"
 
 namespace {
 	LogLevel log_level = kWarn;
+	// すべてのメンバが0の状態が空のリングなので、コンストラクタを呼ばずに使える
+	LogRing log_ring;
 }
 
 extern Console* console;
@@ -24,13 +27,21 @@ int Log(LogLevel level, const char* format, ...) {
 	}
 
 	va_list ap;
-	int result;
-	char s[1024];
-
 	va_start(ap, format);
-	result = vsprintf(s, format, ap);
+	log_ring.Append(level, format, ap);
 	va_end(ap);
 
-	console->PutString(s);
-	return result;
+	// エラーの直後に停止することがあるので、メインループを待たずに画面へ出す
+	if (level == kError) {
+		DrainLog();
+		console->Flush();
+	}
+	return 0;
+}
+
+void DrainLog() {
+	char s[1024];
+	while (log_ring.Pop(s, sizeof(s))) {
+		console->PutString(s);
+	}
 }
\ No newline at end of file
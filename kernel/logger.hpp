@@ -23,8 +23,20 @@ void SetLogLevel(LogLevel level);
  * 
  * 指定された優先度が閾値以上ならば記録する
  * 優先度が閾値未満ならログは捨てられる
+ *
+ * 記録するのは書式文字列と引数だけで、書式化とコンソールへの出力はDrainLogを呼んだときに行う
+ * ロックを取らないので割り込みハンドラからも呼べる。ただしkErrorはその場でコンソールと画面に出力するので、
+ * 割り込みハンドラからはkWarn以下の優先度で記録すること
  * 
  * @param level		ログの優先度
- * @param format	書式文字列、printkと互換
+ * @param format	書式文字列、printkと互換。後で参照するので文字列リテラルを渡すこと
+ * @return 常に0
  */
-int Log(LogLevel level, const char* format, ...);
\ No newline at end of file
+int Log(LogLevel level, const char* format, ...);
+
+/**
+ * @brief 記録済みで未出力のログを書式化してコンソールに出力する
+ *
+ * メインループから1周に1回呼ぶ。割り込みハンドラから呼んではならない
+ */
+void DrainLog();
\ No newline at end of file
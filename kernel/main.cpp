@@ -18,6 +18,7 @@
 #include "memory_map.hpp"
 #include "graphics.hpp"
 #include "mouse.hpp"
+#include "keyboard.hpp"
 #include "font.hpp"
 #include "console.hpp"
 #include "pci.hpp"
@@ -37,6 +38,9 @@ int printk(const char* format, ...) {
 	int result;
 	char s[1024];
 
+	// 先に記録されたログより前に出力されないよう、溜まっているログを出してから書く
+	DrainLog();
+
 	va_start(ap, format);
 	result = vsprintf(s, format, ap);
 	va_end(ap);
@@ -94,6 +98,7 @@ extern "C" void KernelMainNewStack(const FrameBufferConfig& frame_buffer_config_
 	InitializeLayer();
 	InitializeMainWindow();
 	InitializeMouse();
+	InitializeKeyboard();
 	layer_manager->Draw({{0, 0}, ScreenSize()});
 
 	char str[128];
@@ -104,9 +109,12 @@ extern "C" void KernelMainNewStack(const FrameBufferConfig& frame_buffer_config_
 		// カウンタ変数をループ回数で数え、それをウィンドウに表示する
 		++count;
 		sprintf(str, "%010u", count);
-		FillRectangle(*main_window->Writer(), {24, 28}, {8 * 10, 16}, {0xc6, 0xc6, 0xc6});
-		WriteString(*main_window->Writer(), {24, 28}, str, {0, 0, 0});
-		layer_manager->Draw(main_window_layer_id);
+		WriteString(*main_window->Writer(), {24, 28}, str, {0, 0, 0}, {0xc6, 0xc6, 0xc6});
+		// 記録されたログを書式化し、溜まったコンソール出力をまとめて描き、
+		// 書き換えたカウンタ部分とマウス移動などで記録された領域だけを再描画する
+		DrainLog();
+		console->Render();
+		layer_manager->Flush();
 
 		// 割り込み禁止(CPUが外部割り込みを受け取らなくなる)
 		__asm__("cli");
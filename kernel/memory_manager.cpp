@@ -3,59 +3,188 @@
  */
 #include "memory_manager.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 #include "logger.hpp"
+#ifdef USE_BUDDY_ALLOCATOR
+#include "buddy_memory_manager.hpp"
+#endif
+
+namespace {
+	uint64_t ReadTimestampCounter() {
+		uint32_t lo, hi;
+		__asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+		return (static_cast<uint64_t>(hi) << 32) | lo;
+	}
+
+	/**
+	 * @brief ビット列wordsの[begin, end)番目のビットをすべてvalueにする
+	 *
+	 * 両端の要素はマスクで書き換え、間の要素はmemsetでまとめて埋める
+	 */
+	template <typename T>
+	void FillBits(T* words, size_t begin, size_t end, bool value) {
+		const size_t kBits = 8 * sizeof(T);
+		if (begin >= end) {
+			return;
+		}
+
+		const size_t first = begin / kBits;
+		const size_t last = (end - 1) / kBits;
+		const T head_mask = ~static_cast<T>(0) << (begin % kBits);
+		const T tail_mask = ~static_cast<T>(0) >> (kBits - 1 - (end - 1) % kBits);
+		auto apply = [value](T& word, T mask) {
+			word = value ? word | mask : word & ~mask;
+		};
+
+		if (first == last) {
+			apply(words[first], head_mask & tail_mask);
+			return;
+		}
+		apply(words[first], head_mask);
+		memset(&words[first + 1], value ? 0xff : 0, (last - first - 1) * sizeof(T));
+		apply(words[last], tail_mask);
+	}
+}
 
 BitmapMemoryManager::BitmapMemoryManager()
-	: alloc_map_{}, range_begin_{FrameID{0}}, range_end_{FrameID{kFrameCount}} {
+	: alloc_map_{}, full_lines_{}, empty_lines_{},
+	  range_begin_{FrameID{0}}, range_end_{FrameID{kFrameCount}},
+	  frame_cache_{}, cache_count_{0}, cache_stats_{} {
+	empty_lines_.fill(~static_cast<MapLineType>(0));
 }
 
 WithError<FrameID> BitmapMemoryManager::Allocate(size_t num_frames) {
+	if (num_frames != 1) {
+		auto result = AllocateFromMap(num_frames);
+		if (result.error && num_frames > 1 && cache_count_ > 0) {
+			// キャッシュに抱えている分のせいで足りないかもしれないので、ビットマップに戻してやり直す
+			FlushFrameCache(cache_count_);
+			result = AllocateFromMap(num_frames);
+		}
+		return result;
+	}
+
+	if (cache_count_ == 0) {
+		++cache_stats_.misses;
+		RefillFrameCache();
+		if (cache_count_ == 0) {
+			return {kNullFrame, MAKE_ERROR(Error::kNoEnoughMemory)};
+		}
+	} else {
+		++cache_stats_.hits;
+	}
+	return {
+		FrameID{frame_cache_[--cache_count_]},
+		MAKE_ERROR(Error::kSuccess),
+	};
+}
+
+WithError<FrameID> BitmapMemoryManager::AllocateFromMap(size_t num_frames) {
+	const size_t start_frame_id = FindRun(num_frames);
+	if (start_frame_id == range_end_.ID()) {
+		return {kNullFrame, MAKE_ERROR(Error::kNoEnoughMemory)};
+	}
+
+	SetRange(FrameID{start_frame_id}, num_frames, true);
+	return {
+		FrameID{start_frame_id},
+		MAKE_ERROR(Error::kSuccess),
+	};
+}
+
+size_t BitmapMemoryManager::FindRun(size_t num_frames) const {
+	const size_t end = range_end_.ID();
 	size_t start_frame_id = range_begin_.ID();
 	while (true) {
-		// start_frame_idから連続でnum_frames個の空きフレームがあるか確認
-		size_t i = 0;
-		for (; i < num_frames; ++i) {
-			// メモリ範囲の終端を超えたらメモリ不足
-			if (start_frame_id + i >= range_end_.ID()) {
-				return {kNullFrame, MAKE_ERROR(Error::kNoEnoughMemory)};
-			}
-			if (GetBit(FrameID{start_frame_id + i})) {
-				// start_frame_id + iのフレームは割り当て済み
-				// この位置からは連続確保できないので次の位置から再探索
-				break;
-			}
-		}
-		if (i == num_frames) {
+		// 空きフレームまで進み、そこから連続でnum_frames個の空きフレームがあるか確認
+		start_frame_id = FindFree(start_frame_id, end);
+		if (start_frame_id == end || num_frames > end - start_frame_id) {
+			// メモリ範囲の終端を超えたら見つからなかった
+			return end;
+		}
+
+		const size_t used = FindUsed(start_frame_id, start_frame_id + num_frames);
+		if (used == start_frame_id + num_frames) {
 			// num_frames分の連続した空きフレームが見つかった
-			MarkAllocated(FrameID{start_frame_id}, num_frames);
-			return {
-				FrameID{start_frame_id},
-				MAKE_ERROR(Error::kSuccess),
-			};
+			return start_frame_id;
 		}
-		// 割り当て済みフレームの次の位置から再探索
-		start_frame_id += i + 1;
+		// 割り当て済みフレームの位置から再探索
+		start_frame_id = used;
 	}
 }
 
 Error BitmapMemoryManager::Free(FrameID start_frame, size_t num_frames) {
-	for (size_t i = 0; i < num_frames; ++i) {
-		SetBit(FrameID{start_frame.ID() + i}, false);
+	if (num_frames != 1) {
+		SetRange(start_frame, num_frames, false);
+		return MAKE_ERROR(Error::kSuccess);
+	}
+
+	// 1フレームの解放はビットマップを使用中のままキャッシュに積む。溢れそうなら半分をビットマップに戻す
+	if (cache_count_ == kFrameCacheSize) {
+		FlushFrameCache(kFrameCacheSize / 2);
 	}
+	frame_cache_[cache_count_++] = start_frame.ID();
 	return MAKE_ERROR(Error::kSuccess);
 }
 
 void BitmapMemoryManager::MarkAllocated(FrameID start_frame, size_t num_frames) {
-	for (size_t i = 0; i < num_frames; ++i) {
-		SetBit(FrameID{start_frame.ID() + i}, true);
+	// 割り当て済みにする範囲のフレームがキャッシュにあれば取り除き、Allocateで返さないようにする
+	const size_t begin = start_frame.ID();
+	size_t kept = 0;
+	for (size_t i = 0; i < cache_count_; ++i) {
+		if (frame_cache_[i] - begin >= num_frames) {
+			frame_cache_[kept++] = frame_cache_[i];
+		}
 	}
+	cache_count_ = kept;
+
+	SetRange(start_frame, num_frames, true);
 }
 
 void BitmapMemoryManager::SetMemoryRange(FrameID range_begin, FrameID range_end) {
+	FlushFrameCache(cache_count_);
 	range_begin_ = range_begin;
 	range_end_ = range_end;
 }
 
+const BitmapMemoryManager::FrameCacheStats& BitmapMemoryManager::CacheStats() const {
+	return cache_stats_;
+}
+
+void BitmapMemoryManager::RefillFrameCache() {
+	const uint64_t start = ReadTimestampCounter();
+	// 始点から空きフレームを探す。使用中の要素は要約ビットマップで読み飛ばすので、埋まった先頭部分の探索は安い
+	size_t frame = range_begin_.ID();
+	while (cache_count_ < kFrameCacheRefill) {
+		frame = FindFree(frame, range_end_.ID());
+		if (frame == range_end_.ID()) {
+			break;
+		}
+		SetBit(FrameID{frame}, true);
+		frame_cache_[cache_count_++] = frame;
+		++cache_stats_.refilled_frames;
+		++frame;
+	}
+	// 見つけた順に使われるよう、スタックの上に先に見つけたフレームが来るように並べ替える
+	std::reverse(&frame_cache_[0], &frame_cache_[cache_count_]);
+
+	++cache_stats_.refills;
+	cache_stats_.refill_cycles += ReadTimestampCounter() - start;
+}
+
+void BitmapMemoryManager::FlushFrameCache(size_t num_frames) {
+	// キャッシュの底(古いもの)から戻し、最近解放されたフレームを残す
+	num_frames = std::min(num_frames, cache_count_);
+	for (size_t i = 0; i < num_frames; ++i) {
+		SetBit(FrameID{frame_cache_[i]}, false);
+	}
+	std::copy(&frame_cache_[num_frames], &frame_cache_[cache_count_], &frame_cache_[0]);
+	cache_count_ -= num_frames;
+	cache_stats_.flushed_frames += num_frames;
+}
+
 bool BitmapMemoryManager::GetBit(FrameID frame) const {
 	// フレームIDからビットマップ配列のインデックスを計算
 	auto line_index = frame.ID() / kBitsPerMapLine;  // 配列の何番目の要素か
@@ -77,15 +206,104 @@ void BitmapMemoryManager::SetBit(FrameID frame, bool allocated) {
 		// 該当ビットを0にする (空きとしてマーク)
 		alloc_map_[line_index] &= ~(static_cast<MapLineType>(1) << bit_index);
 	}
+	UpdateSummary(line_index);
+}
+
+void BitmapMemoryManager::SetRange(FrameID start_frame, size_t num_frames, bool allocated) {
+	if (num_frames == 0) {
+		return;
+	}
+	const size_t begin = start_frame.ID();
+	const size_t end = begin + num_frames;
+	FillBits(alloc_map_.data(), begin, end, allocated);
+
+	// 範囲に丸ごと含まれる要素は要約もまとめて書き換え、両端の要素だけ中身から要約を求める
+	const size_t first_line = begin / kBitsPerMapLine;
+	const size_t last_line = (end - 1) / kBitsPerMapLine;
+	const size_t whole_begin = (begin + kBitsPerMapLine - 1) / kBitsPerMapLine;
+	const size_t whole_end = end / kBitsPerMapLine;
+	FillBits(full_lines_.data(), whole_begin, whole_end, allocated);
+	FillBits(empty_lines_.data(), whole_begin, whole_end, !allocated);
+	UpdateSummary(first_line);
+	UpdateSummary(last_line);
+}
+
+void BitmapMemoryManager::UpdateSummary(size_t line) {
+	const auto mask = static_cast<MapLineType>(1) << (line % kBitsPerMapLine);
+	auto& full = full_lines_[line / kBitsPerMapLine];
+	auto& empty = empty_lines_[line / kBitsPerMapLine];
+	full = alloc_map_[line] == ~static_cast<MapLineType>(0) ? full | mask : full & ~mask;
+	empty = alloc_map_[line] == 0 ? empty | mask : empty & ~mask;
+}
+
+size_t BitmapMemoryManager::NextLine(
+		const std::array<MapLineType, kMapLineCount / kBitsPerMapLine>& summary,
+		size_t line, size_t limit) const {
+	if (line >= limit) {
+		return limit;
+	}
+	size_t index = line / kBitsPerMapLine;
+	MapLineType bits = ~summary[index] & (~static_cast<MapLineType>(0) << (line % kBitsPerMapLine));
+	while (bits == 0) {
+		++index;
+		if (index * kBitsPerMapLine >= limit) {
+			return limit;
+		}
+		bits = ~summary[index];
+	}
+	return std::min(index * kBitsPerMapLine + __builtin_ctzl(bits), limit);
+}
+
+size_t BitmapMemoryManager::FindFree(size_t frame, size_t limit) const {
+	if (frame >= limit) {
+		return limit;
+	}
+	const size_t limit_line = (limit + kBitsPerMapLine - 1) / kBitsPerMapLine;
+	size_t line = frame / kBitsPerMapLine;
+	MapLineType bits = ~alloc_map_[line] & (~static_cast<MapLineType>(0) << (frame % kBitsPerMapLine));
+	while (bits == 0) {
+		// すべて使用中の要素は要約を見て読み飛ばす
+		line = NextLine(full_lines_, line + 1, limit_line);
+		if (line == limit_line) {
+			return limit;
+		}
+		bits = ~alloc_map_[line];
+	}
+	return std::min(line * kBitsPerMapLine + __builtin_ctzl(bits), limit);
+}
+
+size_t BitmapMemoryManager::FindUsed(size_t frame, size_t limit) const {
+	if (frame >= limit) {
+		return limit;
+	}
+	const size_t limit_line = (limit + kBitsPerMapLine - 1) / kBitsPerMapLine;
+	size_t line = frame / kBitsPerMapLine;
+	MapLineType bits = alloc_map_[line] & (~static_cast<MapLineType>(0) << (frame % kBitsPerMapLine));
+	while (bits == 0) {
+		// すべて空きの要素は要約を見て読み飛ばす
+		line = NextLine(empty_lines_, line + 1, limit_line);
+		if (line == limit_line) {
+			return limit;
+		}
+		bits = alloc_map_[line];
+	}
+	return std::min(line * kBitsPerMapLine + __builtin_ctzl(bits), limit);
 }
 
 extern "C" caddr_t program_break, program_break_end;
 
 namespace {
-	char memory_manager_buf[sizeof(BitmapMemoryManager)];
-	BitmapMemoryManager* memory_manager;
+	// ビルド時にUSE_BUDDY_ALLOCATORを定義するとバディシステムでフレームを管理する
+#ifdef USE_BUDDY_ALLOCATOR
+	using FrameManager = BuddyMemoryManager;
+#else
+	using FrameManager = BitmapMemoryManager;
+#endif
+
+	char memory_manager_buf[sizeof(FrameManager)];
+	FrameManager* memory_manager;
 
-	Error InitializeHeap(BitmapMemoryManager& memory_manager) {
+	Error InitializeHeap(FrameManager& memory_manager) {
 		const int kHeapFrames = 64 * 512;
 		const auto heap_start = memory_manager.Allocate(kHeapFrames);
 		if (heap_start.error) {
@@ -99,7 +317,7 @@ namespace {
 }
 
 void InitializeMemoryManager(const MemoryMap& memory_map) {
-	::memory_manager = new(memory_manager_buf) BitmapMemoryManager;
+	::memory_manager = new(memory_manager_buf) FrameManager;
 
 	const auto memory_map_base = reinterpret_cast<uintptr_t>(memory_map.buffer);
 	uintptr_t available_end = 0;
@@ -123,6 +341,32 @@ void InitializeMemoryManager(const MemoryMap& memory_map) {
 				desc->number_of_pages * kUEFIPageSize / kBytesPerFrame);
 		}
 	}
+
+#ifdef USE_BUDDY_ALLOCATOR
+	// バディシステムはすべて使用中の状態から始まるので、使える領域を空きとして登録する
+	// 解放すると空きブロックの先頭フレームにノードを書き込むので、メモリマップを読み終えるまでは
+	// メモリマップのバッファ(BootServicesDataの領域にある)を壊さないよう、そのフレームは使用中のまま残す
+	const size_t buffer_begin = memory_map_base / kBytesPerFrame;
+	const size_t buffer_end =
+		(memory_map_base + memory_map.map_size + kBytesPerFrame - 1) / kBytesPerFrame;
+	for (uintptr_t iter = memory_map_base;
+		 iter < memory_map_base + memory_map.map_size;
+		 iter += memory_map.descriptor_size) {
+		auto desc = reinterpret_cast<const MemoryDescriptor*>(iter);
+		if (!IsAvailable(static_cast<MemoryType>(desc->type))) {
+			continue;
+		}
+		const size_t begin = desc->physical_start / kBytesPerFrame;
+		const size_t end = begin + desc->number_of_pages * kUEFIPageSize / kBytesPerFrame;
+		if (begin < buffer_begin) {
+			memory_manager->Free(FrameID{begin}, std::min(end, buffer_begin) - begin);
+		}
+		if (buffer_end < end) {
+			const size_t free_begin = std::max(begin, buffer_end);
+			memory_manager->Free(FrameID{free_begin}, end - free_begin);
+		}
+	}
+#endif
 	memory_manager->SetMemoryRange(FrameID{1}, FrameID{available_end / kBytesPerFrame});
 
 	if (auto err = InitializeHeap(*memory_manager)) {
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 #include <limits>
 
 #include "error.hpp"
@@ -69,6 +70,23 @@ public:
 	using MapLineType = unsigned long;
 	// ビットマップ配列の1つの要素のビット数 == 1要素で管理できるフレーム数
 	static const size_t kBitsPerMapLine{8 * sizeof(MapLineType)};
+	// ビットマップ配列の要素数
+	static const size_t kMapLineCount{kFrameCount / kBitsPerMapLine};
+	// 1フレームの割り当て用にキャッシュしておくフレームの最大数と、空のときに1度に補充する数
+	static const size_t kFrameCacheSize{64};
+	static const size_t kFrameCacheRefill{32};
+
+	/**
+	 * @brief 1フレームのキャッシュの統計
+	 */
+	struct FrameCacheStats {
+		// キャッシュから返せた回数と、空で補充が必要になった回数
+		uint64_t hits, misses;
+		// 補充した回数、補充したフレームの合計、補充にかかったタイムスタンプカウンタの合計
+		uint64_t refills, refilled_frames, refill_cycles;
+		// 溢れたりまとめて確保したりするためにビットマップへ戻したフレームの合計
+		uint64_t flushed_frames;
+	};
 
 
 	// インスタンスを初期化する
@@ -78,6 +96,8 @@ public:
 	 * @brief 要求されたフレーム数の領域を確保して先頭のフレームIDを返す
 	 *
 	 * 連続したnum_frames個の空きフレームを探し、見つかったら割り当て済みにする。
+	 * 探索は範囲の始点から行う。64フレーム単位で調べ、すべて使用中の要素とすべて空きの要素は要約ビットマップを見て1度に読み飛ばす。
+	 * 1フレームの要求はフレームキャッシュから取り出し、キャッシュが空のときだけビットマップからまとめて補充する。
 	 *
 	 * @param num_frames 確保したいフレーム数
 	 * @return 確保した領域の先頭フレームIDとエラー情報
@@ -87,6 +107,8 @@ public:
 	/**
 	 * @brief 指定されたフレーム領域を解放する
 	 *
+	 * 1フレームの解放はビットマップに戻さずフレームキャッシュに積む。
+	 *
 	 * @param start_frame 解放する領域の先頭フレーム
 	 * @param num_frames 解放するフレーム数
 	 * @return エラー情報
@@ -111,13 +133,47 @@ public:
 	 */
 	void SetMemoryRange(FrameID range_begin, FrameID range_end);
 
+	/**
+	 * @brief 1フレームのキャッシュの統計を返す
+	 */
+	const FrameCacheStats& CacheStats() const;
+
 private:
 	// ビットマップ配列。各ビットが1フレームの割り当て状態を表す (1=使用中, 0=空き)
-	std::array<MapLineType, kFrameCount / kBitsPerMapLine> alloc_map_;
+	std::array<MapLineType, kMapLineCount> alloc_map_;
+	// alloc_map_の要約。各ビットがalloc_map_の1要素に対応し、
+	// full_lines_はその要素のフレームがすべて使用中なら1、empty_lines_はすべて空きなら1
+	std::array<MapLineType, kMapLineCount / kBitsPerMapLine> full_lines_, empty_lines_;
 	// このメモリマネージャで扱うメモリ範囲の始点
 	FrameID range_begin_;
 	// このメモリマネージャで扱うメモリ範囲の終点。最終フレームの次のフレーム
 	FrameID range_end_;
+	// 1フレームの割り当てに使うフレームのスタック。ここにあるフレームはビットマップ上では使用中
+	std::array<size_t, kFrameCacheSize> frame_cache_;
+	size_t cache_count_;
+	FrameCacheStats cache_stats_;
+
+	/**
+	 * @brief ビットマップから連続したnum_frames個の空きフレームを探して割り当てる
+	 */
+	WithError<FrameID> AllocateFromMap(size_t num_frames);
+
+	/**
+	 * @brief 範囲の始点から、num_frames個の連続した空きフレームを探す
+	 *
+	 * @return 見つけた領域の先頭フレーム。見つからなければ範囲の終点
+	 */
+	size_t FindRun(size_t num_frames) const;
+
+	/**
+	 * @brief ビットマップから最大kFrameCacheRefill個のフレームを割り当ててキャッシュに補充する
+	 */
+	void RefillFrameCache();
+
+	/**
+	 * @brief キャッシュの古い方からnum_frames個のフレームをビットマップに戻す
+	 */
+	void FlushFrameCache(size_t num_frames);
 
 	/**
 	 * @brief 指定されたフレームのビットを取得
@@ -131,6 +187,36 @@ private:
 	 * @param allocated true=割り当て済み, false=空き
 	 */
 	void SetBit(FrameID frame, bool allocated);
+
+	/**
+	 * @brief start_frameから連続するnum_frames個のフレームの割り当て状態をまとめて設定する
+	 *
+	 * ビットマップ配列の要素単位で書き換えるので、かかる時間はフレーム数ではなく要素数に比例する
+	 */
+	void SetRange(FrameID start_frame, size_t num_frames, bool allocated);
+
+	/**
+	 * @brief alloc_map_[line]の内容に合わせて要約ビットマップを更新する
+	 */
+	void UpdateSummary(size_t line);
+
+	/**
+	 * @brief line番目以降でlimit番目より前にある、要約ビットマップsummaryのビットが0の最初の要素の番号を返す
+	 *
+	 * 見つからなければlimitを返す
+	 */
+	size_t NextLine(const std::array<MapLineType, kMapLineCount / kBitsPerMapLine>& summary,
+					size_t line, size_t limit) const;
+
+	/**
+	 * @brief [frame, limit)で最初の空きフレームを返す。なければlimitを返す
+	 */
+	size_t FindFree(size_t frame, size_t limit) const;
+
+	/**
+	 * @brief [frame, limit)で最初の使用中のフレームを返す。なければlimitを返す
+	 */
+	size_t FindUsed(size_t frame, size_t limit) const;
 };
 
 /**
@@ -3,7 +3,6 @@
  */
 #include "mouse.hpp"
 
-#include <limits>
 #include <memory>
 #include "graphics.hpp"
 #include "layer.hpp"
@@ -41,6 +40,11 @@ namespace {
 		"         @.@   ",
 		"         @@@   ",
 	};
+
+	// ドラッグ中のレイヤの不透明度。下にあるものが透けて見えるようにする
+	const uint8_t kDragOpacity = 192;
+	// ドラッグ中のレイヤに対する影の位置
+	const Vector2D<int> kShadowOffset{6, 6};
 }
 
 /**
@@ -60,12 +64,9 @@ void DrawMouseCursor(PixelWriter *pixel_writer, Vector2D<int> position) {
 	}
 }
 
-Mouse::Mouse(unsigned int layer_id) : layer_id_{layer_id} {
-}
-
 void Mouse::SetPosition(Vector2D<int> position) {
 	position_ = position;
-	layer_manager->Move(layer_id_, position_);
+	layer_manager->MoveCursor(position_);
 }
 
 void Mouse::OnInterrupt(uint8_t buttons, int8_t displacement_x, int8_t displacement_y) {
@@ -76,21 +77,43 @@ void Mouse::OnInterrupt(uint8_t buttons, int8_t displacement_x, int8_t displacem
 
 	const auto posdiff = position_ - oldpos;
 
-	layer_manager->Move(layer_id_, position_);
+	layer_manager->MoveCursor(position_);
 
 	const bool previous_left_pressed = (previous_buttons_ & 0x01);
 	const bool left_pressed = (buttons & 0x01);
 	if (!previous_left_pressed && left_pressed) {
-		auto layer = layer_manager->FindLayerByPosition(position_, layer_id_);
+		auto layer = layer_manager->FindLayerByPosition(position_);
 		if (layer && layer->IsDraggable()) {
 			drag_layer_id_ = layer->ID();
+			layer_manager->SetOpacity(drag_layer_id_, kDragOpacity);
+
+			auto window = layer->GetWindow();
+			if (!shadow_window_ || shadow_window_->Width() != window->Width() ||
+				shadow_window_->Height() != window->Height()) {
+				shadow_window_ = std::make_shared<Window>(
+					window->Width(), window->Height(), screen_config.pixel_format);
+				shadow_window_->SetAlphaBlending(true);
+				DrawDropShadow(*shadow_window_);
+			}
+			// 影はドラッグ中のレイヤのすぐ下に挿入する
+			shadow_layer_id_ = layer_manager->NewLayer()
+				.SetWindow(shadow_window_)
+				.Move(layer->GetPosition() + kShadowOffset)
+				.ID();
+			layer_manager->UpDown(shadow_layer_id_, layer->Height());
 		}
 	} else if (previous_left_pressed && left_pressed) {
 		if (drag_layer_id_ > 0) {
+			layer_manager->MoveRelative(shadow_layer_id_, posdiff);
 			layer_manager->MoveRelative(drag_layer_id_, posdiff);
 		}
 	} else if (previous_left_pressed && !left_pressed) {
+		if (drag_layer_id_ > 0) {
+			layer_manager->SetOpacity(drag_layer_id_, 255);
+			layer_manager->RemoveLayer(shadow_layer_id_);
+		}
 		drag_layer_id_ = 0;
+		shadow_layer_id_ = 0;
 	}
 
 	previous_buttons_ = buttons;
@@ -102,13 +125,11 @@ void InitializeMouse() {
 	mouse_window->SetTransparentColor(kMouseTransparentColor);
 	DrawMouseCursor(mouse_window->Writer(), {0, 0});
 
-	auto mouse_layer_id = layer_manager->NewLayer()
-		.SetWindow(mouse_window)
-		.ID();
+	// カーソルはレイヤではなく、LayerManagerが画面に直接重ねて描画する
+	layer_manager->SetCursor(mouse_window);
 
-	auto mouse = std::make_shared<Mouse>(mouse_layer_id);
+	auto mouse = std::make_shared<Mouse>();
 	mouse->SetPosition({200, 200});
-	layer_manager->UpDown(mouse->LayerID(), std::numeric_limits<int>::max());
 
 	usb::HIDMouseDriver::default_observer = 
 		[mouse](uint8_t buttons, int8_t displacement_x, int8_t displacement_y) {
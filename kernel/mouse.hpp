@@ -7,6 +7,8 @@
 
 #include "graphics.hpp"
 
+class Window;
+
 const int kMouseCursorWidth = 15;
 const int kMouseCursorHeight = 24;
 const PixelColor kMouseTransparentColor{0, 0, 1};
@@ -15,18 +17,18 @@ void DrawMouseCursor(PixelWriter* pixel_writer, Vector2D<int> position);
 
 class Mouse {
 public:
-	Mouse(unsigned int layer_id);
 	void OnInterrupt(uint8_t buttons, int8_t displacement_x, int8_t displacement_y);
 
-	unsigned int LayerID() const { return layer_id_; }
 	void SetPosition(Vector2D<int> position);
 	Vector2D<int> Position() const { return position_; }
 
 private:
-	unsigned int layer_id_;
 	Vector2D<int> position_{};
 
 	unsigned int drag_layer_id_{0};
+	// ドラッグ中のレイヤの下に置く影のレイヤと、そのウィンドウ。ウィンドウは同じ大きさなら使い回す
+	unsigned int shadow_layer_id_{0};
+	std::shared_ptr<Window> shadow_window_;
 	uint8_t previous_buttons_{0};
 };
 
@@ -0,0 +1,120 @@
+/**
+ * @file scrollback.cpp
+ */
+#include "scrollback.hpp"
+
+#include <cstring>
+
+namespace {
+	// 1行として格納する最大の文字数
+	const size_t kMaxLineLength = 4096;
+	// この文字数以上同じ文字が続いたら、(0x80 | 個数, 文字)の2バイトに縮める
+	const size_t kMinRun = 4;
+	const size_t kMaxRun = 0x7f;
+
+	/**
+	 * @brief 行を符号化してoutに書き込み、符号化後のバイト数を返す。outがnullptrなら数えるだけ
+	 *
+	 * 0x80未満のバイトは文字そのもの。0x80以上のバイトは下位7ビットが個数で、次のバイトの文字がその個数だけ続く
+	 */
+	size_t EncodeLine(const char* line, size_t len, uint8_t* out) {
+		size_t n = 0;
+		size_t i = 0;
+		while (i < len) {
+			const auto c = static_cast<uint8_t>(line[i]);
+			size_t run = 1;
+			while (i + run < len && run < kMaxRun && static_cast<uint8_t>(line[i + run]) == c) {
+				++run;
+			}
+
+			if (run >= kMinRun || c >= 0x80) {
+				if (out) {
+					out[n] = static_cast<uint8_t>(0x80 | run);
+					out[n + 1] = c;
+				}
+				n += 2;
+				i += run;
+			} else {
+				if (out) {
+					out[n] = c;
+				}
+				++n;
+				++i;
+			}
+		}
+		return n;
+	}
+}
+
+void Scrollback::Append(const char* line) {
+	size_t len = strnlen(line, kMaxLineLength);
+	while (len > 0 && line[len - 1] == ' ') {
+		--len;
+	}
+
+	const size_t encoded_size = EncodeLine(line, len, nullptr);
+	const size_t record_size = 2 + encoded_size;
+
+	if (num_lines_ == kMaxLines) {
+		DropOldest();
+	}
+	// 末尾の残りに収まらなければ先頭から書く。残りの部分にある行は最も古い行なので捨てる
+	if (write_pos_ + record_size > kDataBytes) {
+		while (num_lines_ > 0 && line_offsets_[first_line_] >= write_pos_) {
+			DropOldest();
+		}
+		write_pos_ = 0;
+	}
+	// これから書き込む範囲にある古い行を捨てる
+	while (num_lines_ > 0 &&
+		   line_offsets_[first_line_] >= write_pos_ &&
+		   line_offsets_[first_line_] < write_pos_ + record_size) {
+		DropOldest();
+	}
+
+	data_[write_pos_] = encoded_size & 0xff;
+	data_[write_pos_ + 1] = encoded_size >> 8;
+	EncodeLine(line, len, &data_[write_pos_ + 2]);
+
+	line_offsets_[(first_line_ + num_lines_) % kMaxLines] = write_pos_;
+	++num_lines_;
+	write_pos_ += record_size;
+}
+
+size_t Scrollback::Lines() const {
+	return num_lines_;
+}
+
+size_t Scrollback::GetLine(size_t index, char* buf, size_t size) const {
+	if (size == 0) {
+		return 0;
+	}
+	if (index >= num_lines_) {
+		buf[0] = '\0';
+		return 0;
+	}
+
+	const uint8_t* p = &data_[line_offsets_[(first_line_ + index) % kMaxLines]];
+	const size_t encoded_size = p[0] | (p[1] << 8);
+	p += 2;
+
+	size_t n = 0;
+	for (size_t i = 0; i < encoded_size && n + 1 < size; ++i) {
+		if (p[i] < 0x80) {
+			buf[n++] = p[i];
+			continue;
+		}
+		const size_t run = p[i] & 0x7f;
+		const char c = p[++i];
+		for (size_t j = 0; j < run && n + 1 < size; ++j) {
+			buf[n++] = c;
+		}
+	}
+	buf[n] = '\0';
+	return n;
+}
+
+void Scrollback::DropOldest() {
+	first_line_ = (first_line_ + 1) % kMaxLines;
+	--num_lines_;
+}
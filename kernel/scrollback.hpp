@@ -0,0 +1,58 @@
+/**
+ * @file scrollback.hpp
+ *
+ * 画面から流れ出た行を保持する履歴
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 決まった大きさのメモリに、古い行を押し出しながら文字列の行を溜めておく
+ *
+ * 各行は同じ文字の連続を短く符号化してバイト列のリングバッファに詰める
+ * バイト数か行数のどちらかが上限に達したら、最も古い行から捨てる
+ */
+class Scrollback {
+public:
+	// 行の中身を格納する領域の大きさ
+	static const size_t kDataBytes = 192 * 1024;
+	// 保持できる最大の行数
+	static const size_t kMaxLines = 16384;
+
+	/**
+	 * @brief 行を最も新しい行として追加する
+	 *
+	 * @param line	追加する行(NULL終端)。末尾の空白は取り除いて格納する
+	 */
+	void Append(const char* line);
+
+	/**
+	 * @brief 保持している行数を返す
+	 */
+	size_t Lines() const;
+
+	/**
+	 * @brief index番目の行を復元してbufに書き込む。0番目が最も古い行
+	 *
+	 * @return 書き込んだ文字数。bufに収まらない分は切り捨てる
+	 */
+	size_t GetLine(size_t index, char* buf, size_t size) const;
+
+private:
+	// 符号化した行を並べたリングバッファ。各行の先頭2バイトは符号化後のバイト数
+	uint8_t data_[kDataBytes];
+	// 各行の符号化データがdata_のどこから始まるかを古い順に並べたリングバッファ
+	uint32_t line_offsets_[kMaxLines];
+	// 最も古い行がline_offsets_の何番目にあるか
+	size_t first_line_{0};
+	size_t num_lines_{0};
+	// 次の行を書き込むdata_上の位置
+	size_t write_pos_{0};
+
+	/**
+	 * @brief 最も古い行を捨てる
+	 */
+	void DropOldest();
+};
@@ -2,15 +2,14 @@
  * @file window.cpp
  */
 #include "window.hpp"
+
+#include <algorithm>
+#include <cstring>
 #include "logger.hpp"
 #include "font.hpp"
+#include "blit.hpp"
 
 Window::Window(int width, int height, PixelFormat shadow_format) : width_{width}, height_{height} {
-	data_.resize(height);
-	for (int y = 0; y < height; ++y) {
-		data_[y].resize(width);
-	}
-
 	FrameBufferConfig config{};
 	config.frame_buffer = nullptr;
 	config.horizontal_resolution = width;
@@ -23,23 +22,85 @@ Window::Window(int width, int height, PixelFormat shadow_format) : width_{width}
 	}
 }
 
-void Window::DrawTo(FrameBuffer& dst, Vector2D<int> pos, const Rectangle<int>& area) {
-	// 透過色が設定されていない場合
-	if (!transparent_color_) {
+void Window::DrawTo(FrameBuffer& dst, Vector2D<int> pos, const Rectangle<int>& area,
+					uint8_t opacity) {
+	// 透過も半透明もない場合
+	if (!transparent_color_ && !alpha_blending_ && opacity == 255) {
 		Rectangle<int> window_area{pos, Size()};
 		Rectangle<int> intersection = area & window_area;
-		dst.Copy(intersection.pos, shadow_buffer_, {intersection.pos - pos, intersection.size});
+		if (IsEmpty(intersection)) {
+			return;
+		}
+
+		// スクロールしている場合、シャドウバッファの末尾で折り返す手前と後ろの2回に分けてコピーする
+		const auto src_pos = intersection.pos - pos;
+		const int src_row = (src_pos.y + origin_y_) % height_;
+		const int first_rows = std::min(intersection.size.y, height_ - src_row);
+		dst.Copy(intersection.pos, shadow_buffer_,
+				 {{src_pos.x, src_row}, {intersection.size.x, first_rows}});
+		if (first_rows < intersection.size.y) {
+			dst.Copy(intersection.pos + Vector2D<int>{0, first_rows}, shadow_buffer_,
+					 {{src_pos.x, 0}, {intersection.size.x, intersection.size.y - first_rows}});
+		}
 		return;
 	}
 
 	// 透過色が設定されている場合は、シャドウバッファをコピーすると透明ではなくなってしまうので、透明ではなくなってしまう
-	const auto tc = transparent_color_.value();
-	auto& writer = dst.Writer();
-	for (int y = std::max(0, 0 - pos.y); y < std::min(Height(), writer.Height() - pos.y); ++y) {
-		for (int x = std::max(0, 0 - pos.x); x < std::min(Width(), writer.Width() - pos.x); ++x) {
-			const auto c = At(Vector2D<int>{x, y});
-			if (c != tc) {
-				writer.Write(pos + Vector2D<int>{x, y}, c);
+	// 透過色と一致するピクセルを飛ばしながら、描画対象範囲に含まれる部分だけを1行ずつコピーする
+	// 半透明の場合は下の内容と合成しながら書き込む
+	if (dst.Config().pixel_format != shadow_buffer_.Config().pixel_format) {
+		return;
+	}
+	const Rectangle<int> window_area{pos, Size()};
+	const Rectangle<int> dst_outline{{0, 0}, {
+		static_cast<int>(dst.Config().horizontal_resolution),
+		static_cast<int>(dst.Config().vertical_resolution)}};
+	const auto draw_area = area & window_area & dst_outline;
+	if (IsEmpty(draw_area)) {
+		return;
+	}
+
+	const auto src_pos = draw_area.pos - pos;
+	if (!transparent_color_) {
+		for (int dy = 0; dy < draw_area.size.y; ++dy) {
+			BlendPixels32(dst.PixelAddr(draw_area.pos + Vector2D<int>{0, dy}),
+						  RowAt(src_pos.y + dy) + src_pos.x, draw_area.size.x,
+						  opacity, alpha_blending_);
+		}
+		return;
+	}
+
+	if (!opaque_runs_valid_) {
+		BuildOpaqueRuns();
+	}
+
+	const bool blend = alpha_blending_ || opacity < 255;
+	if (!use_opaque_runs_ && !blend) {
+		const auto tc = EncodePixel(shadow_buffer_.Config().pixel_format, transparent_color_.value());
+		for (int dy = 0; dy < draw_area.size.y; ++dy) {
+			CopyPixelsKeyed32(dst.PixelAddr(draw_area.pos + Vector2D<int>{0, dy}),
+							  RowAt(src_pos.y + dy) + src_pos.x, draw_area.size.x, tc);
+		}
+		return;
+	}
+
+	// 内容が変わっていなければ、不透明区間のうち描画対象範囲に含まれる部分をそのままコピーするだけでよい
+	const int src_x_end = src_pos.x + draw_area.size.x;
+	for (int dy = 0; dy < draw_area.size.y; ++dy) {
+		const int y = src_pos.y + dy;
+		const uint32_t* src_row = RowAt(y);
+		uint32_t* dst_row = dst.PixelAddr(draw_area.pos + Vector2D<int>{0, dy});
+		for (int i = run_index_[y]; i < run_index_[y + 1]; ++i) {
+			const int x0 = std::max(opaque_runs_[i].x, src_pos.x);
+			const int x1 = std::min(opaque_runs_[i].x + opaque_runs_[i].length, src_x_end);
+			if (x0 >= x1) {
+				continue;
+			}
+			if (blend) {
+				BlendPixels32(dst_row + (x0 - src_pos.x), src_row + x0, x1 - x0,
+							  opacity, alpha_blending_);
+			} else {
+				CopyPixels32(dst_row + (x0 - src_pos.x), src_row + x0, x1 - x0);
 			}
 		}
 	}
@@ -47,20 +108,63 @@ void Window::DrawTo(FrameBuffer& dst, Vector2D<int> pos, const Rectangle<int>& a
 
 void Window::SetTransparentColor(std::optional<PixelColor> c) {
 	transparent_color_ = c;
+	opaque_runs_valid_ = false;
+}
+
+void Window::SetAlphaBlending(bool enabled) {
+	alpha_blending_ = enabled;
+}
+
+bool Window::AlphaBlending() const {
+	return alpha_blending_;
+}
+
+bool Window::IsOpaque() const {
+	return !transparent_color_ && !alpha_blending_;
 }
 
 Window::WindowWriter* Window::Writer() {
 	return &writer_;
 }
 
-const PixelColor& Window::At(Vector2D<int> pos) const {
-	return data_[pos.y][pos.x];
+PixelColor Window::At(Vector2D<int> pos) const {
+	const uint32_t pixel = RowAt(pos.y)[pos.x];
+	auto c = DecodePixel(shadow_buffer_.Config().pixel_format, pixel);
+	if (alpha_blending_) {
+		// アルファ値乗算済みの色を元に戻す
+		c.a = pixel >> 24;
+		auto unmul = [a = c.a](uint8_t x) {
+			return a == 0 ? uint8_t{0} : static_cast<uint8_t>(std::min(255, x * 255 / a));
+		};
+		c = {unmul(c.r), unmul(c.g), unmul(c.b), c.a};
+	}
+	return c;
 }
 
 void Window::Write(Vector2D<int> pos, PixelColor c) {
-	data_[pos.y][pos.x] = c;
-	// シャドウバッファにも書き込む
-	shadow_buffer_.Writer().Write(pos, c);
+	RowAt(pos.y)[pos.x] = Encode(c);
+	MarkDirty({pos, {1, 1}});
+}
+
+void Window::FillRect(Vector2D<int> pos, Vector2D<int> size, const PixelColor& c) {
+	if (size.x <= 0 || size.y <= 0) {
+		return;
+	}
+
+	const uint32_t value = Encode(c);
+	for (int y = pos.y; y < pos.y + size.y; ++y) {
+		FillPixels32(RowAt(y) + pos.x, value, size.x);
+	}
+	MarkDirty({pos, size});
+}
+
+void Window::WriteRow(Vector2D<int> pos, const uint32_t* pixels, int n) {
+	if (n <= 0) {
+		return;
+	}
+
+	CopyPixels32(RowAt(pos.y) + pos.x, pixels, n);
+	MarkDirty({pos, {n, 1}});
 }
 
 int Window::Width() const {
@@ -76,7 +180,101 @@ Vector2D<int> Window::Size() const {
 }
 
 void Window::Move(Vector2D<int> dst_pos, const Rectangle<int>& src) {
-	shadow_buffer_.Move(dst_pos, src);
+	if (origin_y_ == 0) {
+		shadow_buffer_.Move(dst_pos, src);
+		MarkDirty({dst_pos, src.size});
+		return;
+	}
+
+	// スクロール中は行の並びが折り返しているので、1行ずつ移動する
+	// 上へ動かすときは上の行から、下へ動かすときは下の行から処理すれば、まだ読んでいない行を上書きしない
+	for (int i = 0; i < src.size.y; ++i) {
+		const int dy = dst_pos.y <= src.pos.y ? i : src.size.y - 1 - i;
+		memmove(RowAt(dst_pos.y + dy) + dst_pos.x, RowAt(src.pos.y + dy) + src.pos.x,
+				sizeof(uint32_t) * src.size.x);
+	}
+	MarkDirty({dst_pos, src.size});
+}
+
+void Window::Scroll(int rows) {
+	origin_y_ = ((origin_y_ + rows) % height_ + height_) % height_;
+	MarkDirty({{0, 0}, Size()});
+}
+
+void Window::CopyFrom(Vector2D<int> dst_pos, const Window& src, const Rectangle<int>& src_area) {
+	const Rectangle<int> src_in_dst{dst_pos, src_area.size};
+	const Rectangle<int> src_outline{dst_pos - src_area.pos, src.Size()};
+	const auto copy_area = Rectangle<int>{{0, 0}, Size()} & src_outline & src_in_dst;
+	if (IsEmpty(copy_area)) {
+		return;
+	}
+
+	const auto src_pos = copy_area.pos - (dst_pos - src_area.pos);
+	for (int dy = 0; dy < copy_area.size.y; ++dy) {
+		CopyPixels32(RowAt(copy_area.pos.y + dy) + copy_area.pos.x,
+					 src.RowAt(src_pos.y + dy) + src_pos.x, copy_area.size.x);
+	}
+	MarkDirty(copy_area);
+}
+
+Rectangle<int> Window::DirtyArea() const {
+	return dirty_area_;
+}
+
+void Window::ClearDirtyArea() {
+	dirty_area_ = {};
+}
+
+uint32_t* Window::RowAt(int y) {
+	return shadow_buffer_.PixelAddr({0, (y + origin_y_) % height_});
+}
+
+const uint32_t* Window::RowAt(int y) const {
+	return shadow_buffer_.PixelAddr({0, (y + origin_y_) % height_});
+}
+
+void Window::MarkDirty(const Rectangle<int>& area) {
+	dirty_area_ = dirty_area_ | area;
+	opaque_runs_valid_ = false;
+}
+
+uint32_t Window::Encode(const PixelColor& c) const {
+	const auto format = shadow_buffer_.Config().pixel_format;
+	if (alpha_blending_) {
+		return EncodePremultipliedPixel(format, c);
+	}
+	return EncodePixel(format, c);
+}
+
+void Window::BuildOpaqueRuns() {
+	const uint32_t tc = EncodePixel(shadow_buffer_.Config().pixel_format, transparent_color_.value());
+	opaque_runs_.clear();
+	run_index_.resize(height_ + 1);
+
+	int opaque_pixels = 0;
+	for (int y = 0; y < height_; ++y) {
+		run_index_[y] = opaque_runs_.size();
+		const uint32_t* row = RowAt(y);
+		int x = 0;
+		while (x < width_) {
+			while (x < width_ && (row[x] & 0x00ffffffu) == tc) {
+				++x;
+			}
+			const int run_start = x;
+			while (x < width_ && (row[x] & 0x00ffffffu) != tc) {
+				++x;
+			}
+			if (run_start < x) {
+				opaque_runs_.push_back({run_start, x - run_start});
+				opaque_pixels += x - run_start;
+			}
+		}
+	}
+	run_index_[height_] = opaque_runs_.size();
+
+	// 区間が平均4ピクセルに満たないほど細切れなら、SIMDでの色比較の方が速い
+	use_opaque_runs_ = opaque_runs_.size() * 4 <= static_cast<size_t>(opaque_pixels);
+	opaque_runs_valid_ = true;
 }
 
 namespace {
@@ -126,7 +324,7 @@ void DrawWindow(PixelWriter& writer, const char* title) {
 	fill_rect({1, win_h - 2}, {win_w - 2, 1},         0x848484);
 	fill_rect({0, win_h - 1}, {win_w, 1},             0x000000);
 
-	WriteString(writer, {24, 4}, title, ToColor(0xffffff));
+	WriteString(writer, {24, 4}, title, ToColor(0xffffff), ToColor(0x000084));
 
 	for (int y = 0; y < kCloseButtonHeight; ++y) {
 		for (int x = 0; x < kCloseButtonWidth; ++x) {
@@ -141,4 +339,18 @@ void DrawWindow(PixelWriter& writer, const char* title) {
 			writer.Write({win_w - 5 - kCloseButtonWidth + x, 5 + y}, c);
 		}
 	}
-}
\ No newline at end of file
+}
+
+void DrawDropShadow(Window& window) {
+	// 縁からkShadowBlurピクセルの間でアルファ値をkShadowAlphaまで上げる
+	const int kShadowBlur = 6;
+	const int kShadowAlpha = 96;
+	const int w = window.Width(), h = window.Height();
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			const int edge = std::min({x, y, w - 1 - x, h - 1 - y, kShadowBlur});
+			const uint8_t a = kShadowAlpha * (edge + 1) / (kShadowBlur + 1);
+			window.Write({x, y}, {0, 0, 0, a});
+		}
+	}
+}
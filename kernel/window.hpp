@@ -3,8 +3,8 @@
  */
 #pragma once
 
-#include <vector>
 #include <optional>
+#include <vector>
 #include "graphics.hpp"
 #include "frame_buffer.hpp"
 
@@ -22,6 +22,34 @@ public:
 		virtual void Write(Vector2D<int> pos, const PixelColor& c) override {
 			window_.Write(pos, c);
 		}
+
+		/**
+		 * @brief 指定された行の範囲を塗りつぶす
+		 */
+		virtual void FillSpan(int y, int x0, int x1, const PixelColor& c) override {
+			window_.FillRect({x0, y}, {x1 - x0, 1}, c);
+		}
+
+		/**
+		 * @brief 指定された長方形を塗りつぶす
+		 */
+		virtual void FillRect(Vector2D<int> pos, Vector2D<int> size, const PixelColor& c) override {
+			window_.FillRect(pos, size, c);
+		}
+
+		/**
+		 * @brief シャドウバッファと同じ形式のピクセル値に変換する
+		 */
+		virtual uint32_t Encode(const PixelColor& c) const override {
+			return window_.Encode(c);
+		}
+
+		/**
+		 * @brief 変換済みのピクセル列をシャドウバッファへまとめて書き込む
+		 */
+		virtual void WriteRow(Vector2D<int> pos, const uint32_t* pixels, int n) override {
+			window_.WriteRow(pos, pixels, n);
+		}
 		
 		/**
 		 * @brief Widthは関連付けられたWindowの横幅をピクセル単位で返す
@@ -51,14 +79,36 @@ public:
 	 * @param dst	描画先
 	 * @param pos	dstの左上を基準としたウィンドウの位置
 	 * @param area	dstの左上を基準とした描画対象範囲
+	 * @param opacity	ウィンドウ全体に掛ける不透明度。255未満なら下の内容とアルファ合成する
 	 */
-	void DrawTo(FrameBuffer& dst, Vector2D<int> position, const Rectangle<int>& area);
+	void DrawTo(FrameBuffer& dst, Vector2D<int> position, const Rectangle<int>& area,
+				uint8_t opacity = 255);
 	
 	/**
 	 * @brief 透過色を設定する
 	 */
 	void SetTransparentColor(std::optional<PixelColor> c);
 
+	/**
+	 * @brief trueにするとピクセルごとのアルファ値(PixelColor::a)を有効にする
+	 *
+	 * 有効な間はアルファ値乗算済みの色とアルファ値をシャドウバッファに格納し、描画時に下の内容と合成する
+	 * 設定を変えても既に書き込まれている内容は変換しないので、描画前に設定すること
+	 */
+	void SetAlphaBlending(bool enabled);
+
+	/**
+	 * @brief ピクセルごとのアルファ値が有効ならtrueを返す
+	 */
+	bool AlphaBlending() const;
+
+	/**
+	 * @brief 描画するとウィンドウの領域全体を塗りつぶすならtrueを返す
+	 *
+	 * 透過色が設定されているウィンドウは下のレイヤが透けて見えるため不透明ではない
+	 */
+	bool IsOpaque() const;
+
 	/**
 	 * @brief このインスタンスに紐付いたWindowWriterを取得する
 	 */
@@ -67,13 +117,25 @@ public:
 	/**
 	 * @brief 指定した位置のピクセルを返す
 	 */
-	const PixelColor& At(Vector2D<int> pos) const;
+	PixelColor At(Vector2D<int> pos) const;
 
 	/**
 	 * @brief 指定した位置にピクセルを書き込む
 	 */
 	void Write(Vector2D<int> pos, PixelColor c);
 
+	/**
+	 * @brief 指定した長方形を塗りつぶす
+	 */
+	void FillRect(Vector2D<int> pos, Vector2D<int> size, const PixelColor& c);
+
+	/**
+	 * @brief posから右へn個のピクセルを書き込む
+	 *
+	 * pixelsはシャドウバッファの形式に変換済みの値とする(WindowWriter::Encodeで作る)
+	 */
+	void WriteRow(Vector2D<int> pos, const uint32_t* pixels, int n);
+
 	/**
 	 * @brief 平面描画領域の横幅をピクセル単位で返す
 	 */
@@ -98,13 +160,86 @@ public:
 	 */
 	void Move(Vector2D<int> dst_pos, const Rectangle<int>& src);
 
+	/**
+	 * @brief ウィンドウの内容全体をrowsピクセルだけ上にずらす
+	 *
+	 * ピクセルは動かさず、シャドウバッファのどの行を0行目とみなすかを変えるだけなので行数によらず定数時間で済む
+	 * 下端に現れる行には上端から押し出された行の内容が残っているので、呼び出し側で描き直すこと
+	 */
+	void Scroll(int rows);
+
+	/**
+	 * @brief 別のウィンドウのsrc_areaの内容を、このウィンドウのdst_posへ複製する
+	 *
+	 * 両方のウィンドウの範囲に収まる部分だけを複製する。シャドウバッファの形式は同じでなければならない
+	 */
+	void CopyFrom(Vector2D<int> dst_pos, const Window& src, const Rectangle<int>& src_area);
+
+	/**
+	 * @brief 前回ClearDirtyAreaを呼んでから書き換えられた領域を返す
+	 *
+	 * 座標はウィンドウの左上を原点とする。書き換えがなければ空の矩形を返す
+	 */
+	Rectangle<int> DirtyArea() const;
+
+	/**
+	 * @brief 書き換えられた領域の記録を消去する
+	 */
+	void ClearDirtyArea();
+
 private:
 	int width_, height_;
-	std::vector<std::vector<PixelColor>> data_{};
 	WindowWriter writer_{*this};
 	std::optional<PixelColor> transparent_color_{std::nullopt};
+	bool alpha_blending_{false};
+	// 書き換えられた領域をすべて含む矩形
+	Rectangle<int> dirty_area_{};
 
+	// 透過色でないピクセルが横に連続する区間
+	struct OpaqueRun {
+		int x, length;
+	};
+	// 全行の不透明区間を上の行から順に並べたもの
+	std::vector<OpaqueRun> opaque_runs_{};
+	// y行目の不透明区間はopaque_runs_[run_index_[y]]からopaque_runs_[run_index_[y + 1]]の手前まで
+	std::vector<int> run_index_{};
+	// opaque_runs_がウィンドウの現在の内容と一致しているならtrue
+	bool opaque_runs_valid_{false};
+	// 区間ごとのコピーが色の比較よりも速いと見込まれるならtrue
+	bool use_opaque_runs_{false};
+
+	// ウィンドウの内容を描画先と同じデータ形式で保持する唯一のバッファ
 	FrameBuffer shadow_buffer_{};
+	// ウィンドウの0行目が格納されているシャドウバッファの行。Scrollで進める
+	int origin_y_{0};
+
+	/**
+	 * @brief ウィンドウのy行目に当たるシャドウバッファの行の先頭を指すポインタを返す
+	 */
+	uint32_t* RowAt(int y);
+	const uint32_t* RowAt(int y) const;
+
+	/**
+	 * @brief 指定した領域を書き換え済みとして記録する。不透明区間のキャッシュは無効になる
+	 */
+	void MarkDirty(const Rectangle<int>& area);
+
+	/**
+	 * @brief 透過色をもとに各行の不透明区間を求め直す
+	 */
+	void BuildOpaqueRuns();
+
+	/**
+	 * @brief 色をシャドウバッファに格納する形式に変換する
+	 */
+	uint32_t Encode(const PixelColor& c) const;
 };
 
-void DrawWindow(PixelWriter& writer, const char* title);
\ No newline at end of file
+void DrawWindow(PixelWriter& writer, const char* title);
+
+/**
+ * @brief ウィンドウ全体に、縁へ向かって薄くなる黒い影を描く
+ *
+ * windowはSetAlphaBlending(true)にしておくこと
+ */
+void DrawDropShadow(Window& window);
\ No newline at end of file